@@ -0,0 +1,242 @@
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CPU.h"
+#include "display.h"
+#include "input.h"
+#include "memory.h"
+#include "snapshot.h"
+#include "vip_timing.h"
+
+// micro and macro benchmarks for the emulator core
+// every result is printed as one JSON object per line:
+//   {"name": ..., "iterations": ..., "ns_per_op": ..., "ops_per_second": ...}
+// so runs can be collected and compared over time
+
+#ifndef ROM_DIR
+#define ROM_DIR "roms"
+#endif
+
+namespace {
+
+volatile uint64_t sink;
+
+template <typename F>
+void run_benchmark(const std::string& name, uint64_t iterations, F&& body) {
+  // warm up caches and branch predictors first
+  for (uint64_t i = 0; i < iterations / 10; ++i) {
+    body(i);
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    body(i);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+
+  std::cout << "{\"name\": \"" << name << "\", \"iterations\": " << iterations
+            << ", \"ns_per_op\": " << seconds * 1e9 / iterations
+            << ", \"ops_per_second\": " << iterations / seconds << "}"
+            << std::endl;
+}
+
+// a headless machine with its own memory, display and keypad
+struct Machine {
+  Memory memory;
+  Display display{true};
+  Input input;
+  CPU cpu{memory, display, input};
+
+  Machine() {
+    cpu.seed(0);
+    memory.load_font();
+  }
+
+  // writes a program at 0x200 and resets the CPU to run it
+  void load_program(const std::vector<uint16_t>& program) {
+    uint16_t address = 0x200;
+    for (uint16_t opcode : program) {
+      memory.write(address++, opcode >> 8);
+      memory.write(address++, opcode & 0xFF);
+    }
+    cpu.initialize();
+    cpu.get_I() = 0x300;
+  }
+};
+
+// 64 copies of an instruction followed by a jump back to 0x200
+std::vector<uint16_t> repeat(uint16_t opcode) {
+  std::vector<uint16_t> program(64, opcode);
+  program.push_back(0x1200);
+  return program;
+}
+
+void bench_opcodes() {
+  struct Family {
+    const char* name;
+    std::vector<uint16_t> program;
+  };
+
+  const std::vector<Family> families = {
+      {"1NNN", {0x1200}},
+      {"2NNN_00EE", {0x2204, 0x1200, 0x00EE}},
+      {"3XNN", repeat(0x3001)},
+      {"6XNN", repeat(0x6A12)},
+      {"7XNN", repeat(0x7A01)},
+      {"8XY4", repeat(0x8AB4)},
+      {"8XY6", repeat(0x8AB6)},
+      {"ANNN", repeat(0xA300)},
+      {"CXNN", repeat(0xCAFF)},
+      {"DXY5", repeat(0xD015)},
+      {"EX9E", repeat(0xE09E)},
+      {"FX1E", repeat(0xF01E)},
+      {"FX33", repeat(0xFA33)},
+      {"FX55", repeat(0xFF55)},
+      {"FX65", repeat(0xFF65)},
+  };
+
+  for (const Family& family : families) {
+    Machine machine;
+    machine.load_program(family.program);
+    run_benchmark(std::string("opcode/") + family.name, 20000000,
+                  [&](uint64_t) { machine.cpu.step(); });
+  }
+}
+
+void bench_draw_sprite() {
+  struct Position {
+    const char* name;
+    uint8_t x;
+    uint8_t y;
+  };
+
+  const Position positions[] = {
+      {"aligned", 8, 8}, {"unaligned", 11, 8}, {"wrapping", 60, 30}};
+
+  Machine machine;
+  const uint8_t sprite[15] = {0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF,
+                              0x3C, 0x42, 0x99, 0xA5, 0x99, 0x42, 0x3C};
+
+  for (int height : {1, 5, 15}) {
+    for (const Position& position : positions) {
+      run_benchmark("draw_sprite/h" + std::to_string(height) + "/" +
+                        position.name,
+                    5000000, [&](uint64_t) {
+                      sink = machine.display.draw_sprite(position.x, position.y,
+                                                         sprite, height);
+                    });
+    }
+  }
+}
+
+void bench_expand() {
+  Machine machine;
+  machine.load_program(repeat(0xD01F));
+  for (int i = 0; i < 1000; ++i) {
+    machine.cpu.step();
+  }
+
+  std::vector<uint32_t> pixels(Display::WIDTH * Display::HEIGHT);
+  run_benchmark("display/expand", 200000, [&](uint64_t) {
+    machine.display.expand(pixels.data(), Display::WIDTH);
+    sink = pixels[0];
+  });
+}
+
+void bench_snapshots() {
+  Machine machine;
+  Snapshot snapshot;
+  machine.cpu.save_snapshot(snapshot);
+
+  run_benchmark("snapshot/save", 1000000,
+                [&](uint64_t) { machine.cpu.save_snapshot(snapshot); });
+  run_benchmark("snapshot/load", 1000000,
+                [&](uint64_t) { machine.cpu.load_snapshot(snapshot); });
+  run_benchmark("snapshot/state_hash", 10000000,
+                [&](uint64_t) { sink = machine.cpu.state_hash(); });
+}
+
+void bench_memory() {
+  Machine machine;
+  run_benchmark("memory/read", 100000000, [&](uint64_t i) {
+    sink = machine.memory.read(uint16_t(i));
+  });
+  run_benchmark("memory/write", 100000000, [&](uint64_t i) {
+    machine.memory.write(uint16_t(0x300 + (i & 0xFF)), uint8_t(i));
+  });
+}
+
+const char* const ROMS[] = {
+    "games/Pong (1 player).ch8",
+    "games/Tetris [Fran Dachille, 1991].ch8",
+    "games/Space Invaders [David Winter].ch8",
+    "games/Brix [Andreas Gustafsson, 1990].ch8",
+    "games/Blinky [Hans Christian Egeberg, 1991].ch8",
+};
+
+// a key pressed now and then
+uint16_t bench_keys(uint64_t frame) {
+  return (frame / 30) % 3 == 0 ? 1u << ((frame / 90) % 16) : 0;
+}
+
+// whole ROMs for a fixed instruction count
+void bench_roms() {
+  const int instructions_per_frame = 10;
+  const uint64_t frames = 1000000;
+
+  for (const char* rom : ROMS) {
+    Machine machine;
+    std::string path = std::string(ROM_DIR) + "/" + rom;
+    if (!machine.memory.load_rom(path.c_str())) {
+      continue;
+    }
+    run_benchmark(std::string("rom/") + rom, frames, [&](uint64_t frame) {
+      machine.input.set_keys(bench_keys(frame));
+      machine.cpu.run_frame(instructions_per_frame);
+    });
+  }
+}
+
+// the same ROMs with the COSMAC VIP timing; a real VIP does 60 frames per
+// second, so ops_per_second / 60 is the speed-up over it
+void bench_vip_timing() {
+  const uint64_t frames = 1000000;
+
+  for (const char* rom : ROMS) {
+    Machine machine;
+    std::string path = std::string(ROM_DIR) + "/" + rom;
+    if (!machine.memory.load_rom(path.c_str())) {
+      continue;
+    }
+    VipTiming timing(machine.cpu);
+    run_benchmark(std::string("vip/") + rom, frames, [&](uint64_t frame) {
+      machine.input.set_keys(bench_keys(frame));
+      timing.run_frame();
+    });
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+
+  auto selected = [&](const char* group) {
+    return filter.empty() || filter == group;
+  };
+
+  if (selected("opcode")) bench_opcodes();
+  if (selected("draw_sprite")) bench_draw_sprite();
+  if (selected("display")) bench_expand();
+  if (selected("snapshot")) bench_snapshots();
+  if (selected("memory")) bench_memory();
+  if (selected("rom")) bench_roms();
+  if (selected("vip")) bench_vip_timing();
+  return 0;
+}
@@ -2,11 +2,19 @@
 
 #include <array>
 #include <cstdint>
-#include <random>
+#include <memory>
 
+#include "call_graph.h"
+#include "debugger.h"
+#include "diagnostics.h"
 #include "display.h"
 #include "input.h"
 #include "memory.h"
+#include "profiler.h"
+#include "quirks.h"
+#include "random.h"
+#include "snapshot.h"
+#include "trace.h"
 
 class CPU {
  public:
@@ -14,8 +22,73 @@ class CPU {
   void initialize();
   void cycle();
 
-  std::default_random_engine rand_gen;
-  std::uniform_int_distribution<uint8_t> rand_byte;
+  // cycle() split in its parts: step() runs a single instruction and
+  // update_timers() ticks the timers once; run_frame() runs a whole 60 Hz
+  // frame worth of instructions followed by end_frame(), which ticks the
+  // timers and hands pending diagnostics over
+  void step();
+  void update_timers();
+  void end_frame();
+  void run_frame(int instructions);
+
+  // batch execution: runs up to the given number of instructions (no timer
+  // tick) and says why it stopped
+  // run<true>() checks the attached debugger's breakpoints before and its
+  // watchpoints after every instruction; run<false>() is the plain loop, so
+  // a run without debugging pays nothing for the feature
+  template <bool Debug = false>
+  StopReason run(int instructions);
+
+  // save and restore the whole machine (memory, display, keypad included)
+  void save_snapshot(Snapshot& snapshot) const;
+  void load_snapshot(const Snapshot& snapshot);
+
+  // 64-bit hash of the full machine state (memory, registers, stack, timers
+  // and framebuffer), used to recognize already visited states
+  uint64_t state_hash() const;
+
+  // true if the sound timer was running during the last timer tick, that is
+  // if the frame that just ended should be heard
+  bool is_sound_playing() const;
+
+  // random numbers for CXNN (PCG32 unless another source is plugged in)
+  void seed(uint64_t seed);
+  void set_random_source(std::unique_ptr<RandomSource> source);
+  uint8_t random_byte();
+
+  // variant whose quirks the interpreter follows (COSMAC VIP by default)
+  void set_quirks(QuirkProfile profile);
+  QuirkProfile get_quirks() const;
+
+  // number of unknown opcodes executed so far
+  uint64_t get_unknown_opcode_count() const;
+
+  // unknown opcodes are reported to the attached diagnostics (if any) and
+  // handled according to the policy; a halted CPU stays on the opcode until
+  // it is reinitialized or a snapshot is loaded
+  void set_diagnostics(Diagnostics* diagnostics);
+  void set_unknown_opcode_policy(UnknownOpcodePolicy policy);
+  bool is_halted() const;
+  // stops on the instruction just executed (SUPER-CHIP 00FD exit)
+  void halt();
+
+  // attach an execution trace to step() (nullptr to detach)
+  void set_trace(ExecutionTrace* trace);
+
+  // while replaying instructions that already ran once (History seeking
+  // back), unknown opcodes are neither counted nor reported and nothing is
+  // traced or profiled again; the debugger still sees everything
+  void set_replaying(bool replaying);
+
+  // attach a debugger for run<true>() (nullptr to detach); its watchpoints
+  // only see memory accesses in builds with C8EMU_DEBUGGER
+  void set_debugger(Debugger* debugger);
+
+#ifdef C8EMU_PROFILE
+  // attach profilers to step() (nullptr to detach)
+  void set_profiler(Profiler* profiler);
+  void set_call_graph(CallGraphProfiler* call_graph);
+#endif
 
   // getters
   Memory& get_memory();
@@ -30,6 +103,9 @@ class CPU {
   uint16_t* get_stack();
   uint8_t& get_delay_timer();
   uint8_t& get_sound_timer();
+  uint8_t* get_flags();
+  uint8_t* get_audio_pattern();
+  uint8_t& get_pitch();
 
  private:
   // registers
@@ -51,9 +127,49 @@ class CPU {
   // timers
   uint8_t delay_timer;
   uint8_t sound_timer;
+  bool sound_playing = false;
+
+  // SUPER-CHIP RPL user flags, saved and loaded by FX75 and FX85
+  std::array<uint8_t, 16> flags;
+
+  // XO-CHIP audio: 128 one-bit samples played in a loop while the sound
+  // timer runs, at 4000 * 2^((pitch - 64) / 48) samples per second
+  std::array<uint8_t, 16> audio_pattern;
+  uint8_t pitch;
 
-  // opcode execution logic
+  std::unique_ptr<RandomSource> random;
+
+  QuirkProfile quirks = QuirkProfile::cosmac_vip;
+
+  // instrumentation, step() takes the slow path when any of it is attached
+  bool instrumented = false;
+  bool halted = false;
+  bool replaying = false;
+  uint64_t unknown_opcodes = 0;
+  Diagnostics* diagnostics = nullptr;
+  UnknownOpcodePolicy unknown_opcode_policy = UnknownOpcodePolicy::nop;
+  ExecutionTrace* trace = nullptr;
+  Debugger* debugger = nullptr;
+#ifdef C8EMU_PROFILE
+  Profiler* profiler = nullptr;
+  CallGraphProfiler* call_graph = nullptr;
+#endif
+
+  // opcode execution logic, instantiated once per quirk profile
+  template <typename Quirks>
+  void step_as();
+  template <typename Quirks>
   void process_opcode(uint16_t opcode);
+  template <typename Quirks>
+  void instrumented_step(uint16_t opcode);
+  void update_instrumented();
+  void report_unknown_opcode(uint16_t opcode);
+  // SUPER-CHIP and XO-CHIP additions to the 0, 5 and F groups, false if the
+  // opcode isn't one of them
+  bool process_schip_opcode(uint16_t opcode);
+  bool process_xo_chip_opcode(uint16_t opcode);
+  template <typename Quirks>
+  void process_extended_opcode(uint16_t opcode);
 };
 
 // getters
@@ -73,3 +189,78 @@ inline uint8_t& CPU::get_sp() { return sp; }
 inline uint16_t* CPU::get_stack() { return stack.data(); }
 inline uint8_t& CPU::get_delay_timer() { return delay_timer; }
 inline uint8_t& CPU::get_sound_timer() { return sound_timer; }
+inline uint8_t* CPU::get_flags() { return flags.data(); }
+inline uint8_t* CPU::get_audio_pattern() { return audio_pattern.data(); }
+inline uint8_t& CPU::get_pitch() { return pitch; }
+inline uint8_t CPU::random_byte() { return random->next_byte(); }
+inline bool CPU::is_sound_playing() const { return sound_playing; }
+
+inline void CPU::set_quirks(QuirkProfile profile) { quirks = profile; }
+inline QuirkProfile CPU::get_quirks() const { return quirks; }
+
+inline uint64_t CPU::get_unknown_opcode_count() const {
+  return unknown_opcodes;
+}
+
+inline void CPU::set_diagnostics(Diagnostics* new_diagnostics) {
+  diagnostics = new_diagnostics;
+}
+inline void CPU::set_unknown_opcode_policy(UnknownOpcodePolicy policy) {
+  unknown_opcode_policy = policy;
+}
+inline bool CPU::is_halted() const { return halted; }
+
+inline void CPU::set_trace(ExecutionTrace* new_trace) {
+  trace = new_trace;
+  update_instrumented();
+}
+inline void CPU::set_replaying(bool new_replaying) {
+  replaying = new_replaying;
+  update_instrumented();
+}
+
+inline void CPU::set_debugger(Debugger* new_debugger) {
+  debugger = new_debugger;
+#ifdef C8EMU_DEBUGGER
+  memory.set_debugger(new_debugger);
+#endif
+}
+
+template <bool Debug>
+StopReason CPU::run(int instructions) {
+  if constexpr (Debug) {
+    // forget accesses made outside of run()
+    debugger->take_watch_hit();
+  }
+
+  for (int i = 0; i < instructions; ++i) {
+    if (halted) {
+      return StopReason::halted;
+    }
+    if constexpr (Debug) {
+      if (debugger->check_breakpoint(pc, V.data())) {
+        return StopReason::breakpoint;
+      }
+    }
+
+    step();
+
+    if constexpr (Debug) {
+      if (debugger->take_watch_hit()) {
+        return StopReason::watchpoint;
+      }
+    }
+  }
+  return halted ? StopReason::halted : StopReason::completed;
+}
+
+#ifdef C8EMU_PROFILE
+inline void CPU::set_profiler(Profiler* new_profiler) {
+  profiler = new_profiler;
+  update_instrumented();
+}
+inline void CPU::set_call_graph(CallGraphProfiler* new_call_graph) {
+  call_graph = new_call_graph;
+  update_instrumented();
+}
+#endif
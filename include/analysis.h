@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+
+// straight-line run of instructions with a single entry and a single exit
+struct BasicBlock {
+  enum Exit : uint8_t {
+    fall_through,  // runs into the next block, which something else jumps to
+    jump,          // 1NNN
+    call,          // 2NNN, continues after the call on return
+    skip,          // 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1
+    ret,           // 00EE
+    indirect,      // BNNN, the target depends on V0
+    halt,          // 00FD, the SUPER-CHIP interpreter stops
+    off_end,       // runs off the end of the program
+  };
+
+  uint16_t start;
+  uint32_t end;  // one past the last instruction, 0x10000 at the top of 64K
+  Exit exit;
+  std::vector<uint16_t> successors;  // call target first for calls
+};
+
+// static analysis of a loaded program
+// control flow is followed recursively from the entry point through jumps,
+// calls and skips, which separates the reachable code from sprites and other
+// data and splits it into basic blocks; the result is meant to be computed
+// once at load time by anything that wants to know what is code before
+// running it (listings, decode caches, translators)
+//
+// BNNN jumps through V0 can't be followed statically: their blocks end as
+// indirect and whatever they reach is reported as data
+class ProgramAnalysis {
+ public:
+  // analyzes memory[origin, origin + size), entering at origin
+  ProgramAnalysis(const Memory::Data& memory, uint16_t origin, size_t size);
+
+  // true if a reachable instruction starts at the address
+  bool is_instruction(uint16_t address) const;
+  // true if the byte belongs to a reachable instruction
+  bool is_code(uint16_t address) const;
+
+  const std::map<uint16_t, BasicBlock>& get_blocks() const;
+  const std::set<uint16_t>& get_subroutines() const;
+  // operands of ANNN, usually sprites or tables
+  const std::set<uint16_t>& get_data_references() const;
+  // jump and call targets outside the program
+  const std::set<uint16_t>& get_external_targets() const;
+
+  size_t get_code_size() const;
+
+  // annotated disassembly, data as DB lines
+  void write_listing(std::ostream& out) const;
+  // one node per basic block, edges labeled by how control gets there
+  void write_graphviz(std::ostream& out) const;
+
+ private:
+  Memory::Data memory;
+  uint16_t origin;
+  uint32_t end;
+
+  std::bitset<Memory::SIZE> instructions;
+  std::bitset<Memory::SIZE> code;
+  std::set<uint16_t> leaders;
+  std::set<uint16_t> targets;  // entry, jump, call and skip targets
+  std::map<uint16_t, BasicBlock> blocks;
+  std::set<uint16_t> subroutines;
+  std::set<uint16_t> data_references;
+  std::set<uint16_t> external_targets;
+
+  uint16_t fetch(uint16_t address) const;
+  // 4 bytes for XO-CHIP's F000 NNNN, 2 for everything else
+  uint16_t instruction_size(uint16_t address) const;
+  std::string instruction_text(uint16_t address) const;
+  bool in_program(uint16_t address) const;
+  void trace(uint16_t entry);
+  void build_blocks();
+  void write_label(std::ostream& out, uint16_t address) const;
+};
+
+inline bool ProgramAnalysis::is_instruction(uint16_t address) const {
+  return instructions.test(address & Memory::ADDRESS_MASK);
+}
+inline bool ProgramAnalysis::is_code(uint16_t address) const {
+  return code.test(address & Memory::ADDRESS_MASK);
+}
+inline const std::map<uint16_t, BasicBlock>& ProgramAnalysis::get_blocks()
+    const {
+  return blocks;
+}
+inline const std::set<uint16_t>& ProgramAnalysis::get_subroutines() const {
+  return subroutines;
+}
+inline const std::set<uint16_t>& ProgramAnalysis::get_data_references() const {
+  return data_references;
+}
+inline const std::set<uint16_t>& ProgramAnalysis::get_external_targets()
+    const {
+  return external_targets;
+}
+inline size_t ProgramAnalysis::get_code_size() const { return code.count(); }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SDL.h"
+#include "spsc_queue.h"
+
+class CPU;
+
+// destination of the synthesized samples (16-bit signed mono)
+// write() is called from the emulation thread and must not block
+class AudioSink {
+ public:
+  virtual ~AudioSink() = default;
+  virtual void write(const int16_t* samples, size_t count) = 0;
+};
+
+// turns the sound state of the machine into samples, one 60 Hz frame at a
+// time, on the emulation thread
+// a frame sounds when the sound timer ran through it, so the tone starts and
+// stops exactly on the frame boundaries the timer does; frames hold a
+// fractional number of samples, the remainder is carried to the next one so
+// the stream never drifts from the emulated time
+// the tone is a square wave, or the XO-CHIP audio pattern once the program
+// has loaded a non-empty one
+class AudioSynth {
+ public:
+  static const int BEEP_FREQUENCY = 440;
+  static const int16_t AMPLITUDE = 6000;
+
+  explicit AudioSynth(int sample_rate);
+
+  // renders the frame the CPU just finished into the sink
+  void render_frame(CPU& cpu, AudioSink& sink);
+
+  int get_sample_rate() const;
+
+ private:
+  int sample_rate;
+  int sample_remainder;  // in 1/60 samples
+  double phase;          // beep cycles or pattern bits, wrapped
+  std::vector<int16_t> buffer;
+};
+
+// plays samples through the default SDL audio device
+// write() only pushes into a lock-free ring and the device callback only pops
+// from it (playing silence when it runs dry), so neither the emulation nor
+// the audio thread ever waits on the other
+// samples are dropped instead of queued when the ring already holds more than
+// the target latency, which keeps the delay bounded when emulation runs ahead
+class SdlAudio : public AudioSink {
+ public:
+  static const size_t RING_CAPACITY = 16384;
+
+  // buffer_samples is the size of the device buffer, the main latency knob
+  explicit SdlAudio(int sample_rate = 44100, int buffer_samples = 512);
+  ~SdlAudio() override;
+
+  SdlAudio(const SdlAudio&) = delete;
+  SdlAudio& operator=(const SdlAudio&) = delete;
+
+  // false if no device could be opened (writes are then discarded)
+  bool is_open() const;
+  int get_sample_rate() const;
+  int get_buffer_samples() const;
+
+  void write(const int16_t* samples, size_t count) override;
+
+  // time a sample written now waits before it is played: what is left in
+  // the ring plus one device buffer
+  uint64_t get_latency_ns() const;
+  uint64_t get_underruns() const;
+  uint64_t get_dropped() const;
+
+ private:
+  static void callback(void* self, Uint8* stream, int length);
+
+  SDL_AudioDeviceID device = 0;
+  int sample_rate;
+  int buffer_samples;
+  size_t max_queued;
+
+  SpscQueue<int16_t, RING_CAPACITY> ring;
+  std::atomic<uint64_t> underruns{0};
+  uint64_t dropped = 0;  // owned by the emulation thread
+};
+
+inline int AudioSynth::get_sample_rate() const { return sample_rate; }
+
+inline bool SdlAudio::is_open() const { return device != 0; }
+inline int SdlAudio::get_sample_rate() const { return sample_rate; }
+inline int SdlAudio::get_buffer_samples() const { return buffer_samples; }
+inline uint64_t SdlAudio::get_underruns() const {
+  return underruns.load(std::memory_order_relaxed);
+}
+inline uint64_t SdlAudio::get_dropped() const { return dropped; }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// pieces shared by the binary file formats (the ROM library index, ROM
+// bundles and WAV recordings): little-endian integers and a pool of strings
+// that records refer to with (u32 offset, u32 length) fields
+
+template <typename T>
+T load_le(const uint8_t* in) {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= T(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+template <typename T>
+void store_le(uint8_t* out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out[i] = uint8_t((value >> (8 * i)) & 0xFF);
+  }
+}
+
+template <typename T>
+void store_le(std::vector<uint8_t>& out, T value) {
+  out.resize(out.size() + sizeof(T));
+  store_le(out.data() + out.size() - sizeof(T), value);
+}
+
+// the strings of a file being written
+struct StringPool {
+  std::string bytes;
+
+  // appends text to the pool and its field to out
+  void add(std::vector<uint8_t>& out, std::string_view text) {
+    store_le(out, uint32_t(bytes.size()));
+    store_le(out, uint32_t(text.size()));
+    bytes.append(text.data(), text.size());
+  }
+};
+
+// true if the field at in refers to bytes within a pool of pool_size
+inline bool string_fits(const uint8_t* in, uint64_t pool_size) {
+  return uint64_t(load_le<uint32_t>(in)) + load_le<uint32_t>(in + 4) <=
+         pool_size;
+}
+
+// the string the field at in refers to, in a pool already checked with
+// string_fits()
+inline std::string_view load_string(const char* pool, const uint8_t* in) {
+  return std::string_view(pool + load_le<uint32_t>(in),
+                          load_le<uint32_t>(in + 4));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "quirks.h"
+#include "snapshot.h"
+
+// finds how fast a ROM needs to run: the machine is played headless at
+// several instructions per frame settings in parallel, with a key pressed now
+// and then, and for each one the fraction of instructions spent polling the
+// delay timer is measured
+// a program that spins on the timer has finished its frame's work early, so
+// the pick is the lowest setting that leaves at least min_wait of the time to
+// such waits; programs that never wait on the timer pace themselves by the
+// instruction rate alone and get the fallback
+struct CalibrationOptions {
+  std::vector<int> candidates = {5, 7, 10, 12, 15, 20, 25, 30, 40, 50};
+  QuirkProfile quirks = QuirkProfile::cosmac_vip;
+  int frames = 7200;  // two minutes of play per setting
+  double min_wait = 0.1;
+  int fallback = 10;
+  unsigned threads = 0;  // 0 = one per hardware thread
+};
+
+struct SpeedMeasurement {
+  int instructions_per_frame;
+  double wait_fraction;
+};
+
+struct CalibrationResult {
+  int instructions_per_frame = 0;
+  bool paced = false;  // the program waited on the delay timer at all
+  std::vector<SpeedMeasurement> measurements;  // in candidate order
+  double seconds = 0.0;
+};
+
+CalibrationResult calibrate(const Snapshot& root,
+                            const CalibrationOptions& options);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+// guest call-graph profiler: keeps a shadow call stack from 2NNN/00EE and
+// attributes every executed instruction to the current stack path
+// paths are stored as a trie of function entry points, so an instruction only
+// costs one counter increment and a call one hash lookup
+// only built with -DC8EMU_PROFILE=ON
+class CallGraphProfiler {
+ public:
+  // deeper (usually runaway recursive) calls are folded into the last frame
+  static const int MAX_DEPTH = 64;
+
+  CallGraphProfiler();
+
+  void execute(uint16_t opcode);
+  void reset();
+
+  // writes collapsed stacks ("main;sub_2a4;sub_300 1234" per line), the input
+  // format of flamegraph.pl and speedscope
+  void write_collapsed(std::ostream& out) const;
+
+ private:
+  struct Node {
+    uint32_t parent;
+    uint16_t entry;
+    int depth;
+    uint64_t instructions;
+  };
+
+  void call(uint16_t entry);
+  void ret();
+
+  std::vector<Node> nodes;
+  std::unordered_map<uint64_t, uint32_t> children;
+  uint32_t current;
+  int overflow;
+};
+
+inline void CallGraphProfiler::execute(uint16_t opcode) {
+  ++nodes[current].instructions;
+  if ((opcode & 0xF000u) == 0x2000u) {
+    call(opcode & 0x0FFFu);
+  } else if (opcode == 0x00EEu) {
+    ret();
+  }
+}
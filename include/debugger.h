@@ -0,0 +1,126 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "memory.h"
+
+// why CPU::run() returned
+enum class StopReason {
+  completed,   // ran the requested number of instructions
+  breakpoint,  // about to execute an instruction with a breakpoint on it
+  watchpoint,  // the last instruction touched a watched address
+  halted,      // the CPU is halted on an unknown opcode
+};
+
+// extra test on a register, checked only when the breakpoint's pc is reached
+struct BreakCondition {
+  enum Compare : uint8_t { eq, ne, lt, gt };
+
+  uint8_t reg;  // V0 to VF
+  Compare compare;
+  uint8_t value;
+
+  bool holds(const uint8_t* V) const;
+};
+
+// breakpoints and watchpoints for one machine
+// every address of the 4KB space has a bit in a breakpoint, read-watch and
+// write-watch bitmap, so the checks on the execution path are a single bit
+// test; conditions live on the side and are only looked at on a hit
+//
+// breakpoints are checked by CPU::run<true>(); watchpoints need the memory
+// hooks, which are only compiled in with C8EMU_DEBUGGER
+class Debugger {
+ public:
+  struct WatchHit {
+    uint16_t address;
+    bool write;
+  };
+
+  // a breakpoint with conditions only triggers when all of them hold
+  void add_breakpoint(uint16_t pc);
+  void add_breakpoint(uint16_t pc, BreakCondition condition);
+  void remove_breakpoint(uint16_t pc);
+
+  void add_watchpoint(uint16_t address, bool on_read, bool on_write);
+  void remove_watchpoint(uint16_t address);
+
+  void clear();
+
+  bool should_break(uint16_t pc, const uint8_t* V) const;
+
+  // should_break() for the execution loop: after stopping on a breakpoint,
+  // the next check lets the instruction through so execution can resume
+  bool check_breakpoint(uint16_t pc, const uint8_t* V);
+
+  // memory hooks
+  void on_read(uint16_t address);
+  void on_write(uint16_t address);
+
+  // true (once) if a watched address was touched since the last call
+  bool take_watch_hit();
+  const WatchHit& get_watch_hit() const;
+
+ private:
+  std::bitset<Memory::SIZE> breakpoints;
+  std::bitset<Memory::SIZE> read_watches;
+  std::bitset<Memory::SIZE> write_watches;
+  std::unordered_map<uint16_t, std::vector<BreakCondition>> conditions;
+
+  int stopped_pc = -1;
+  bool watch_hit = false;
+  WatchHit last_hit = {0, false};
+};
+
+inline bool Debugger::should_break(uint16_t pc, const uint8_t* V) const {
+  if (!breakpoints.test(pc & Memory::ADDRESS_MASK)) {
+    return false;
+  }
+  auto it = conditions.find(pc & Memory::ADDRESS_MASK);
+  if (it == conditions.end()) {
+    return true;
+  }
+  for (const BreakCondition& condition : it->second) {
+    if (!condition.holds(V)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool Debugger::check_breakpoint(uint16_t pc, const uint8_t* V) {
+  bool resuming = pc == stopped_pc;
+  stopped_pc = -1;
+  if (resuming || !should_break(pc, V)) {
+    return false;
+  }
+  stopped_pc = pc;
+  return true;
+}
+
+inline void Debugger::on_read(uint16_t address) {
+  if (read_watches.test(address)) {
+    watch_hit = true;
+    last_hit = {address, false};
+  }
+}
+
+inline void Debugger::on_write(uint16_t address) {
+  if (write_watches.test(address)) {
+    watch_hit = true;
+    last_hit = {address, true};
+  }
+}
+
+inline bool Debugger::take_watch_hit() {
+  bool hit = watch_hit;
+  watch_hit = false;
+  return hit;
+}
+
+inline const Debugger::WatchHit& Debugger::get_watch_hit() const {
+  return last_hit;
+}
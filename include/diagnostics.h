@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "spsc_queue.h"
+
+// what the CPU does when it meets an unknown opcode
+enum class UnknownOpcodePolicy {
+  nop,   // treat it as a no-op and report it
+  skip,  // treat it as a no-op without reporting it (still counted)
+  halt,  // report it and stop executing at the opcode
+};
+
+enum class AnomalyKind : uint8_t {
+  unknown_opcode,
+};
+
+// aggregated anomaly reporting for one machine
+// the emulation thread coalesces repeats of the same anomaly and pushes them
+// into a lock-free queue; a background thread counts them by kind, pc and
+// opcode and prints a summary at most once per interval, so a ROM stuck on an
+// unsupported opcode can't grind the emulator down with I/O
+class Diagnostics {
+ public:
+  explicit Diagnostics(
+      std::ostream& out,
+      std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+  ~Diagnostics();
+
+  Diagnostics(const Diagnostics&) = delete;
+  Diagnostics& operator=(const Diagnostics&) = delete;
+
+  // called from the emulation thread, never block
+  void report(AnomalyKind kind, uint16_t pc, uint16_t opcode);
+  void flush();
+
+  // flushes only once the logger has caught up, so running uncapped doesn't
+  // flood the queue with tiny batches
+  void flush_if_idle();
+
+  uint64_t get_dropped() const;
+
+ private:
+  // only the busiest sites are listed in each summary
+  static const int MAX_SUMMARY_LINES = 8;
+
+  // repeats are pushed in batches of at most this many
+  static const uint32_t MAX_BATCH = 65536;
+
+  struct Event {
+    AnomalyKind kind;
+    uint16_t pc;
+    uint16_t opcode;
+    uint32_t count;
+  };
+
+  using Site = std::tuple<AnomalyKind, uint16_t, uint16_t>;
+
+  void run();
+  void drain();
+  void print_summary(const std::map<Site, uint64_t>& counts,
+                     const char* title);
+
+  std::ostream& out;
+  std::chrono::milliseconds interval;
+
+  SpscQueue<Event, 4096> queue;
+  std::atomic<uint64_t> dropped{0};
+
+  // owned by the emulation thread
+  Event pending{AnomalyKind::unknown_opcode, 0, 0, 0};
+
+  // owned by the logger thread
+  std::map<Site, uint64_t> interval_counts;
+  std::map<Site, uint64_t> total_counts;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::thread logger;
+};
+
+inline void Diagnostics::report(AnomalyKind kind, uint16_t pc,
+                                uint16_t opcode) {
+  if (pending.count && pending.kind == kind && pending.pc == pc &&
+      pending.opcode == opcode) {
+    if (++pending.count == MAX_BATCH) {
+      flush();
+    }
+    return;
+  }
+  flush();
+  pending = {kind, pc, opcode, 1};
+}
+
+inline void Diagnostics::flush() {
+  if (pending.count == 0) {
+    return;
+  }
+  if (!queue.push(pending)) {
+    dropped.fetch_add(pending.count, std::memory_order_relaxed);
+  }
+  pending.count = 0;
+}
+
+inline uint64_t Diagnostics::get_dropped() const {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+inline void Diagnostics::flush_if_idle() {
+  if (pending.count && queue.size() == 0) {
+    flush();
+  }
+}
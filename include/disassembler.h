@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// returns the mnemonic for an opcode (e.g. "LD VA, 0x12"), using the same
+// names as the comments in opcodes.h; unknown opcodes come out as "DW 0xNNNN"
+std::string disassemble(uint16_t opcode);
@@ -2,23 +2,126 @@
 
 #include <array>
 #include <cstdint>
+#include <string>
 
 #include "SDL.h"
+#include "state_hash.h"
 
 class Display {
  public:
-  static const int WIDTH = 64;
-  static const int HEIGHT = 32;
-  static const int SCALE = 10;
+  // the framebuffer has room for the SUPER-CHIP 128x64 high resolution mode;
+  // in low resolution only the top-left 64x32 pixels are used
+  static const int WIDTH = 128;
+  static const int HEIGHT = 64;
+  static const int LORES_WIDTH = 64;
+  static const int LORES_HEIGHT = 32;
+  static const int SCALE = 10;  // window pixels per low resolution pixel
+  // XO-CHIP bit planes; everything else only ever selects the first one
+  static const int PLANES = 2;
+  static const uint32_t ON_COLOR = 0xFFFFFFFF;  // first plane
+  static const uint32_t OFF_COLOR = 0xFF000000;
+  static const uint32_t PLANE2_COLOR = 0xFFAAAAAA;
+  static const uint32_t BLEND_COLOR = 0xFF555555;  // both planes
+  static const uint32_t OVERLAY_COLOR = 0xFF00FF00;
 
-  Display();
+  // one row of pixels as a 128-bit value split in two words, leftmost pixel
+  // in the top bit of the first one, so sprites and scrolls are shifts
+  using Row = std::array<uint64_t, 2>;
+  using Plane = std::array<Row, HEIGHT>;
+  using Screen = std::array<Plane, PLANES>;
+
+  // a headless display keeps the framebuffer but never touches SDL, so many
+  // of them can run side by side on worker threads
+  explicit Display(bool headless = false);
   ~Display();
+  // clears the selected planes
   void clear();
-  bool draw_sprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t n);
   void render();
 
+  // switching the resolution clears every plane
+  void set_hires(bool hires);
+  bool is_hires() const;
+  int get_width() const;
+  int get_height() const;
+  bool get_pixel(int x, int y, int plane = 0) const;
+
+  // planes that drawing, clearing and scrolling apply to, one bit each
+  // (XO-CHIP FN01); only the first one is selected by default
+  void set_planes(uint8_t mask);
+  uint8_t get_planes() const;
+
+  // draws an 8-pixel wide sprite of n rows at (x, y) in every selected
+  // plane, returns true on collision in any of them
+  // the sprite holds n bytes per selected plane, one plane after the other
+  // the position wraps around the screen; pixels past the right and bottom
+  // edges wrap around too, or are clipped when Wrap is false
+  template <bool Wrap = true>
+  bool draw_sprite(uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t n);
+
+  // same for a 16x16 sprite of 32 bytes per plane, two per row (SCHIP DXY0)
+  template <bool Wrap = true>
+  bool draw_sprite16(uint8_t x, uint8_t y, const uint8_t* sprite);
+
+  // SCHIP and XO-CHIP scrolling of the selected planes, in pixels of the
+  // current resolution
+  void scroll_up(int rows);
+  void scroll_down(int rows);
+  void scroll_right();  // by 4 pixels
+  void scroll_left();   // by 4 pixels
+
+  // text drawn over the framebuffer in render() with the built-in font
+  // (hex digits only, any other character leaves a gap)
+  void set_overlay(const std::string& text);
+
+  // expands the framebuffer to WIDTH x HEIGHT 32-bit ARGB pixels (stride in
+  // pixels); low resolution pixels are doubled, and pixels lit in the second
+  // plane take its colors
+  void expand(uint32_t* pixels, int stride) const;
+
+  // Zobrist-style hash of the lit pixels, the resolution and the selected
+  // planes, kept up to date by the drawing methods
+  uint64_t get_hash() const;
+
+  // raw access for snapshots
+  const Screen& get_screen() const;
+  void restore(const Screen& pixels, uint64_t pixels_hash, bool hires,
+               uint8_t planes);
+
  private:
-  std::array<std::array<bool, WIDTH>, HEIGHT> screen;
+  // folded into the hash in high resolution and with other planes selected,
+  // so that states showing the same pixels still hash differently
+  static constexpr uint64_t HIRES_KEY = 0x5C41C8D15B1A7001ull;
+  static constexpr uint64_t PLANES_KEY = 0x9A7E5C41C8D15B00ull;
+
+  Screen screen;
+  uint64_t hash;  // of the lit pixels only
+  bool hires;
+  uint8_t planes;
   SDL_Window* window;
   SDL_Renderer* renderer;
+  SDL_Texture* texture;
+  std::string overlay;
+
+  template <bool Wrap>
+  Row row_mask(int x, uint64_t bits) const;
+  bool draw_row(int plane, int y, const Row& mask);
+  void rehash();
+  uint64_t mode_key() const;
+  void draw_overlay(uint32_t* pixels, int stride) const;
 };
+
+inline uint64_t Display::mode_key() const {
+  return (hires ? HIRES_KEY : 0) ^
+         (planes != 1 ? mix64(PLANES_KEY | planes) : 0);
+}
+inline uint64_t Display::get_hash() const { return hash ^ mode_key(); }
+inline const Display::Screen& Display::get_screen() const { return screen; }
+inline bool Display::is_hires() const { return hires; }
+inline int Display::get_width() const { return hires ? WIDTH : LORES_WIDTH; }
+inline int Display::get_height() const {
+  return hires ? HEIGHT : LORES_HEIGHT;
+}
+inline bool Display::get_pixel(int x, int y, int plane) const {
+  return (screen[plane][y][x >> 6] >> (63 - (x & 63))) & 1u;
+}
+inline uint8_t Display::get_planes() const { return planes; }
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "CPU.h"
+#include "debugger.h"
+#include "snapshot.h"
+
+// reverse execution for one machine
+// the history drives the CPU one instruction at a time, keeps a snapshot
+// every interval instructions in a ring of capacity entries and logs every
+// keypad change; an earlier instruction is reached by restoring the nearest
+// snapshot before it and re-executing from there, which replays exactly
+// because the RNG state is part of the snapshot and the input comes from the
+// log
+//
+// positions count executed instructions, and the timers tick after every
+// instructions_per_frame of them like they do with CPU::run_frame()
+// with the defaults a step back re-executes at most 4096 instructions and the
+// ring holds about 6.5 MB, which reaches two hours back at 10 instructions
+// per frame; anything older is forgotten
+class History {
+ public:
+  History(CPU& cpu, int instructions_per_frame, uint64_t interval = 4096,
+          size_t capacity = 1024);
+
+  void step();
+  void run_frame();
+
+  // keypad changes must go through here to be replayed
+  void set_keys(uint16_t keys);
+
+  uint64_t get_position() const;
+  uint64_t get_oldest_position() const;
+
+  // moves back to an earlier position and forgets everything after it, so
+  // execution continues live from there; false if it is out of reach
+  bool seek(uint64_t target);
+  bool step_back(uint64_t instructions = 1);
+
+  // moves back to the last breakpoint (before its instruction) or watchpoint
+  // hit (after the access) before the current position; completed if there
+  // is none within reach, in which case the position doesn't change
+  // watchpoints are only seen when the debugger is also attached to the CPU
+  StopReason reverse_continue(Debugger& debugger);
+
+ private:
+  struct Checkpoint {
+    uint64_t position;
+    Snapshot snapshot;
+  };
+
+  struct KeyEvent {
+    uint64_t position;
+    uint16_t keys;
+  };
+
+  CPU& cpu;
+  int instructions_per_frame;
+  uint64_t interval;
+  size_t capacity;
+
+  // ring of snapshots at consecutive multiples of interval, oldest at first
+  std::vector<Checkpoint> checkpoints;
+  size_t first;
+  size_t count;
+
+  // keypad changes after the oldest checkpoint, in order
+  std::deque<KeyEvent> key_events;
+  size_t next_event;  // next event to apply while re-executing
+
+  uint64_t position;
+
+  Checkpoint& checkpoint(size_t offset);
+  void take_checkpoint();
+  size_t checkpoint_before(uint64_t target) const;
+  void restore(size_t offset);
+  void replay_to(size_t offset, uint64_t target);
+  void execute();
+  void replay_step();
+};
+
+inline uint64_t History::get_position() const { return position; }
+inline History::Checkpoint& History::checkpoint(size_t offset) {
+  return checkpoints[(first + offset) % checkpoints.size()];
+}
@@ -15,10 +15,16 @@
 class Input {
  public:
   Input();
-  void handle_event(const SDL_Event& event);
+  // returns true if the event changed the keypad state
+  bool handle_event(const SDL_Event& event);
   bool is_key_down(uint8_t key) const;
   bool is_any_key_down() const;
 
+  // keypad state as a bitmask (bit N set = key N down), used to drive the
+  // keypad programmatically
+  uint16_t get_keys() const;
+  void set_keys(uint16_t mask);
+
  private:
   std::array<bool, 16> key_state;
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// read-only view of a whole file, memory-mapped where the platform allows it
+// (the pages are only read in when touched) and read into a buffer elsewhere
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // false if the file can't be opened or mapped; an empty file maps to an
+  // empty view
+  bool open(const std::string& filename);
+  void close();
+
+  bool is_open() const;
+  const uint8_t* data() const;
+  size_t size() const;
+
+ private:
+  const uint8_t* view = nullptr;
+  size_t length = 0;
+  bool opened = false;
+  bool mapped = false;          // view must be unmapped
+  std::vector<uint8_t> buffer;  // without mmap
+};
+
+inline bool MappedFile::is_open() const { return opened; }
+inline const uint8_t* MappedFile::data() const { return view; }
+inline size_t MappedFile::size() const { return length; }
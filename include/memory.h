@@ -1,19 +1,99 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <string>
 
 #include "fonts.h"
+#include "state_hash.h"
+
+class Debugger;
+
+// why a ROM image couldn't be loaded
+struct RomError {
+  enum class Code : uint8_t {
+    none,
+    open_failed,  // missing or unreadable file, or not a regular file
+    empty,
+    too_large,  // doesn't fit in the memory of this build
+    corrupt,    // a bundle entry that doesn't match its content hash
+  };
+
+  Code code = Code::none;
+  std::string source;  // file name, or the name of the bundle entry
+  size_t size = 0;     // of the image, when it is known
+  size_t limit = 0;    // largest image the memory holds
+
+  // one line for the user, naming the source and the sizes involved
+  std::string message() const;
+
+  // fills in error, or prints the message if the caller passed none; always
+  // false, so that loaders can return it
+  static bool report(Code code, const std::string& source, size_t size,
+                     RomError* error);
+};
 
 class Memory {
  public:
+  // CHIP-8 has 4KB of memory; XO-CHIP programs address 64KB, which builds
+  // with C8EMU_MEMORY_64K provide (at the cost of larger snapshots)
+  // addresses wrap around at the end of the space either way
+#ifdef C8EMU_MEMORY_64K
+  static const size_t SIZE = 0x10000;
+#else
+  static const size_t SIZE = 0x1000;
+#endif
+  static const uint16_t ADDRESS_MASK = uint16_t(SIZE - 1);
+  using Data = std::array<uint8_t, SIZE>;
+  // programs are loaded here and may fill the rest of the space
+  static const uint16_t ROM_START = 0x200;
+  static const size_t MAX_ROM_SIZE = SIZE - ROM_START;
+
   Memory();
-  void load_rom(const char* filename);
+  // loads a ROM image at ROM_START, with one copy out of a read-only mapping
+  // of the file; on failure nothing is loaded and false is returned, with
+  // the reason in error, or printed to std::cerr if no error is passed
+  bool load_rom(const char* filename, RomError* error = nullptr);
+  // same from an image already in memory (a mapped bundle entry), which
+  // source names in errors
+  bool load_rom(const uint8_t* data, size_t size, const std::string& source,
+                RomError* error = nullptr);
   void load_font();
+  size_t get_rom_size() const;
+  uint64_t get_rom_hash() const;
   uint8_t read(uint16_t address) const;
   void write(uint16_t address, uint8_t value);
   const uint8_t* get_pointer(uint16_t address) const;
 
+  // Zobrist-style hash of the memory contents, kept up to date by write()
+  uint64_t get_hash() const;
+  void rehash();
+
+  // raw access for snapshots
+  const Data& get_data() const;
+  void restore(const Data& data, uint64_t data_hash);
+
+#ifdef C8EMU_DEBUGGER
+  // report reads and writes to the debugger's watchpoints (nullptr to detach)
+  void set_debugger(Debugger* debugger);
+#endif
+
  private:
-  std::array<uint8_t, 4096> memory;  // CHIP-8 has 4KB of memory
+  Data memory;
+  uint64_t hash;
+  size_t rom_size;
+#ifdef C8EMU_DEBUGGER
+  Debugger* debugger = nullptr;
+#endif
 };
+
+inline uint64_t Memory::get_hash() const { return hash; }
+inline size_t Memory::get_rom_size() const { return rom_size; }
+inline const Memory::Data& Memory::get_data() const { return memory; }
+
+#ifdef C8EMU_DEBUGGER
+inline void Memory::set_debugger(Debugger* new_debugger) {
+  debugger = new_debugger;
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "quirks.h"
+
+// input movie: the keypad state of every frame, run-length encoded, together
+// with everything needed to reproduce the session (ROM hash, RNG seed,
+// instructions per frame and quirk profile)
+// 0 instructions per frame stands for the COSMAC VIP timing (vip_timing.h)
+//
+// file layout (little endian):
+//   "C8MV", u16 version, u16 instructions per frame, u64 ROM hash, u64 seed,
+//   u8 quirk profile, u32 run count, then per run: u16 key mask, LEB128 frame
+//   count
+class Movie {
+ public:
+  struct Run {
+    uint16_t keys;
+    uint32_t frames;
+  };
+
+  Movie();
+  Movie(uint64_t rom_hash, uint64_t seed, uint16_t instructions_per_frame,
+        QuirkProfile quirks);
+
+  // appends one frame played with the given keypad state
+  void record(uint16_t keys);
+
+  bool save(const char* filename) const;
+  bool load(const char* filename);
+
+  uint64_t get_rom_hash() const;
+  uint64_t get_seed() const;
+  uint16_t get_instructions_per_frame() const;
+  QuirkProfile get_quirks() const;
+  const std::vector<Run>& get_runs() const;
+  size_t frame_count() const;
+
+ private:
+  static const uint16_t VERSION = 2;
+
+  uint64_t rom_hash;
+  uint64_t seed;
+  uint16_t instructions_per_frame;
+  QuirkProfile quirks;
+  std::vector<Run> runs;
+};
+
+inline uint64_t Movie::get_rom_hash() const { return rom_hash; }
+inline uint64_t Movie::get_seed() const { return seed; }
+inline uint16_t Movie::get_instructions_per_frame() const {
+  return instructions_per_frame;
+}
+inline QuirkProfile Movie::get_quirks() const { return quirks; }
+inline const std::vector<Movie::Run>& Movie::get_runs() const { return runs; }
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// opcode families as handled by CPU::process_opcode, used to group statistics
+// (profiling, diagnostics) by instruction
+enum OpcodeFamily : uint8_t {
+  OP_00E0,
+  OP_00EE,
+  OP_00CN,
+  OP_00DN,
+  OP_00FB,
+  OP_00FC,
+  OP_00FD,
+  OP_00FE,
+  OP_00FF,
+  OP_1NNN,
+  OP_2NNN,
+  OP_3XNN,
+  OP_4XNN,
+  OP_5XY0,
+  OP_5XY2,
+  OP_5XY3,
+  OP_6XNN,
+  OP_7XNN,
+  OP_8XY0,
+  OP_8XY1,
+  OP_8XY2,
+  OP_8XY3,
+  OP_8XY4,
+  OP_8XY5,
+  OP_8XY6,
+  OP_8XY7,
+  OP_8XYE,
+  OP_9XY0,
+  OP_ANNN,
+  OP_BNNN,
+  OP_CXNN,
+  OP_DXYN,
+  OP_EX9E,
+  OP_EXA1,
+  OP_F000,
+  OP_FN01,
+  OP_F002,
+  OP_FX07,
+  OP_FX0A,
+  OP_FX15,
+  OP_FX18,
+  OP_FX1E,
+  OP_FX29,
+  OP_FX30,
+  OP_FX33,
+  OP_FX3A,
+  OP_FX55,
+  OP_FX65,
+  OP_FX75,
+  OP_FX85,
+  OP_UNKNOWN,
+  OPCODE_FAMILY_COUNT
+};
+
+const std::array<const char*, OPCODE_FAMILY_COUNT> opcode_family_names = {
+    "00E0", "00EE", "00CN", "00DN", "00FB", "00FC", "00FD", "00FE",
+    "00FF", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "5XY2", "5XY3",
+    "6XNN", "7XNN", "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5",
+    "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+    "EX9E", "EXA1", "F000", "FN01", "F002", "FX07", "FX0A", "FX15",
+    "FX18", "FX1E", "FX29", "FX30", "FX33", "FX3A", "FX55", "FX65",
+    "FX75", "FX85", "unknown"};
+
+inline OpcodeFamily opcode_family(uint16_t opcode) {
+  switch (opcode & 0xF000u) {
+    case 0x0000:
+      switch (opcode & 0x00FFu) {
+        case 0xE0:
+          return OP_00E0;
+        case 0xEE:
+          return OP_00EE;
+        case 0xFB:
+          return OP_00FB;
+        case 0xFC:
+          return OP_00FC;
+        case 0xFD:
+          return OP_00FD;
+        case 0xFE:
+          return OP_00FE;
+        case 0xFF:
+          return OP_00FF;
+        default:
+          switch (opcode & 0x00F0u) {
+            case 0xC0:
+              return OP_00CN;
+            case 0xD0:
+              return OP_00DN;
+            default:
+              return OP_UNKNOWN;
+          }
+      }
+    case 0x1000:
+      return OP_1NNN;
+    case 0x2000:
+      return OP_2NNN;
+    case 0x3000:
+      return OP_3XNN;
+    case 0x4000:
+      return OP_4XNN;
+    case 0x5000:
+      switch (opcode & 0x000Fu) {
+        case 0x2:
+          return OP_5XY2;
+        case 0x3:
+          return OP_5XY3;
+        default:
+          return OP_5XY0;
+      }
+    case 0x6000:
+      return OP_6XNN;
+    case 0x7000:
+      return OP_7XNN;
+    case 0x8000:
+      switch (opcode & 0x000Fu) {
+        case 0x0:
+          return OP_8XY0;
+        case 0x1:
+          return OP_8XY1;
+        case 0x2:
+          return OP_8XY2;
+        case 0x3:
+          return OP_8XY3;
+        case 0x4:
+          return OP_8XY4;
+        case 0x5:
+          return OP_8XY5;
+        case 0x6:
+          return OP_8XY6;
+        case 0x7:
+          return OP_8XY7;
+        case 0xE:
+          return OP_8XYE;
+        default:
+          return OP_UNKNOWN;
+      }
+    case 0x9000:
+      return OP_9XY0;
+    case 0xA000:
+      return OP_ANNN;
+    case 0xB000:
+      return OP_BNNN;
+    case 0xC000:
+      return OP_CXNN;
+    case 0xD000:
+      return OP_DXYN;
+    case 0xE000:
+      switch (opcode & 0x00FFu) {
+        case 0x9E:
+          return OP_EX9E;
+        case 0xA1:
+          return OP_EXA1;
+        default:
+          return OP_UNKNOWN;
+      }
+    default:
+      switch (opcode & 0x00FFu) {
+        case 0x00:
+          return opcode == 0xF000 ? OP_F000 : OP_UNKNOWN;
+        case 0x01:
+          return OP_FN01;
+        case 0x02:
+          return opcode == 0xF002 ? OP_F002 : OP_UNKNOWN;
+        case 0x07:
+          return OP_FX07;
+        case 0x0A:
+          return OP_FX0A;
+        case 0x15:
+          return OP_FX15;
+        case 0x18:
+          return OP_FX18;
+        case 0x1E:
+          return OP_FX1E;
+        case 0x29:
+          return OP_FX29;
+        case 0x30:
+          return OP_FX30;
+        case 0x33:
+          return OP_FX33;
+        case 0x3A:
+          return OP_FX3A;
+        case 0x55:
+          return OP_FX55;
+        case 0x65:
+          return OP_FX65;
+        case 0x75:
+          return OP_FX75;
+        case 0x85:
+          return OP_FX85;
+        default:
+          return OP_UNKNOWN;
+      }
+  }
+}
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <bitset>
+
 #include "CPU.h"
+#include "quirks.h"
+
+// handlers whose behavior differs between CHIP-8 variants take the quirks of
+// the running profile (see quirks.h) as a template parameter
 
 // macros for easier access to CPU getters
 // this is just for convenience
@@ -20,47 +26,114 @@ inline void opcode_00E0(CPU& cpu) { display.clear(); }
 
 // 00EE: return from a subroutine (RET)
 inline void opcode_00EE(CPU& cpu) {
-  pc = stack[sp];
+  pc = stack[sp & 0xFu];
   sp--;
 }
 
+// 00CN: scroll the screen down by N pixels (SCD nibble) [SUPER-CHIP]
+inline void opcode_00CN(CPU& cpu, uint16_t opcode) {
+  display.scroll_down(opcode & 0x000Fu);
+}
+
+// 00DN: scroll the screen up by N pixels (SCU nibble) [XO-CHIP]
+inline void opcode_00DN(CPU& cpu, uint16_t opcode) {
+  display.scroll_up(opcode & 0x000Fu);
+}
+
+// 00FB: scroll the screen right by 4 pixels (SCR) [SUPER-CHIP]
+inline void opcode_00FB(CPU& cpu) { display.scroll_right(); }
+
+// 00FC: scroll the screen left by 4 pixels (SCL) [SUPER-CHIP]
+inline void opcode_00FC(CPU& cpu) { display.scroll_left(); }
+
+// 00FD: exit the interpreter (EXIT) [SUPER-CHIP]
+inline void opcode_00FD(CPU& cpu) { cpu.halt(); }
+
+// 00FE: switch to 64x32 low resolution (LOW) [SUPER-CHIP]
+inline void opcode_00FE(CPU& cpu) { display.set_hires(false); }
+
+// 00FF: switch to 128x64 high resolution (HIGH) [SUPER-CHIP]
+inline void opcode_00FF(CPU& cpu) { display.set_hires(true); }
+
+// skips the next instruction; XO-CHIP skips F000 NNNN as a whole
+template <typename Quirks>
+inline void skip_next(CPU& cpu) {
+  if (Quirks::xo_chip_instructions && memory.read(pc) == 0xF0 &&
+      memory.read(pc + 1) == 0x00) {
+    pc += 4;
+  } else {
+    pc += 2;
+  }
+}
+
 // 1NNN: jump to address NNN (JP addr)
 inline void opcode_1NNN(CPU& cpu, uint16_t opcode) { pc = opcode & 0x0FFFu; }
 
 // 2NNN: call subroutine at NNN (CALL addr)
 inline void opcode_2NNN(CPU& cpu, uint16_t opcode) {
   sp++;
-  stack[sp] = pc;
+  stack[sp & 0xFu] = pc;
   pc = opcode & 0x0FFFu;
 }
 
 // 3XNN: skip next instruction if VX equals NN (SE Vx, byte)
+template <typename Quirks>
 inline void opcode_3XNN(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t byte = opcode & 0x00FFu;
 
   if (VX == byte) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
   }
 }
 
 // 4XNN: skip next instruction if VX doesn't equal NN (SNE Vx, byte)
+template <typename Quirks>
 inline void opcode_4XNN(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t byte = opcode & 0x00FFu;
 
   if (VX != byte) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
   }
 }
 
 // 5XY0: skip next instruction if VX equals VY (SE Vx, Vy)
+template <typename Quirks>
 inline void opcode_5XY0(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
 
   if (VX == VY) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
+  }
+}
+
+// 5XY2: store VX to VY (in either order) in memory starting at address I,
+// leaving I unchanged (LD [I], Vx-Vy) [XO-CHIP]
+inline void opcode_5XY2(CPU& cpu, uint16_t opcode) {
+  int x = (opcode & 0x0F00u) >> 8u;
+  int y = (opcode & 0x00F0u) >> 4u;
+  int step = x <= y ? 1 : -1;
+  for (int i = 0, reg = x;; ++i, reg += step) {
+    memory.write(I + i, V[reg]);
+    if (reg == y) {
+      break;
+    }
+  }
+}
+
+// 5XY3: load VX to VY (in either order) from memory starting at address I,
+// leaving I unchanged (LD Vx-Vy, [I]) [XO-CHIP]
+inline void opcode_5XY3(CPU& cpu, uint16_t opcode) {
+  int x = (opcode & 0x0F00u) >> 8u;
+  int y = (opcode & 0x00F0u) >> 4u;
+  int step = x <= y ? 1 : -1;
+  for (int i = 0, reg = x;; ++i, reg += step) {
+    V[reg] = memory.read(I + i);
+    if (reg == y) {
+      break;
+    }
   }
 }
 
@@ -89,27 +162,39 @@ inline void opcode_8XY0(CPU& cpu, uint16_t opcode) {
 }
 
 // 8XY1: set VX to VX OR VY (OR Vx, Vy)
+template <typename Quirks>
 inline void opcode_8XY1(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
 
   VX |= VY;
+  if constexpr (Quirks::logic_resets_vf) {
+    V[0xF] = 0;
+  }
 }
 
 // 8XY2: set VX to VX AND VY (AND Vx, Vy)
+template <typename Quirks>
 inline void opcode_8XY2(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
 
   VX &= VY;
+  if constexpr (Quirks::logic_resets_vf) {
+    V[0xF] = 0;
+  }
 }
 
 // 8XY3: set VX to VX XOR VY (XOR Vx, Vy)
+template <typename Quirks>
 inline void opcode_8XY3(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
 
   VX ^= VY;
+  if constexpr (Quirks::logic_resets_vf) {
+    V[0xF] = 0;
+  }
 }
 
 // 8XY4: add VY to VX, set VF to 1 if there's a carry, 0 otherwise (ADD Vx, Vy)
@@ -134,12 +219,17 @@ inline void opcode_8XY5(CPU& cpu, uint16_t opcode) {
 }
 
 // 8XY6: store the least significant bit of VX in VF and then shift VX to
-// the right by 1 (SHR Vx)
+// the right by 1 (SHR Vx); the COSMAC VIP shifts VY into VX instead
+template <typename Quirks>
 inline void opcode_8XY6(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
+  uint8_t source = Quirks::shift_uses_vy ? cpu.get_vy(opcode) : VX;
+
+  uint8_t flag = source & 0x1;
 
-  V[0xF] = VX & 0x1;
-  VX >>= 1;
+  // VF last, so that 8FY6 leaves the flag
+  VX = source >> 1;
+  V[0xF] = flag;
 }
 
 // 8XY7: set VX to VY minus VX, set VF to 0 if there's a borrow, 1 otherwise
@@ -153,30 +243,39 @@ inline void opcode_8XY7(CPU& cpu, uint16_t opcode) {
 }
 
 // 8XYE: store the most significant bit of VX in VF and then shift VX to the
-// left by 1 (SHL Vx {, Vy})
+// left by 1 (SHL Vx {, Vy}); the COSMAC VIP shifts VY into VX instead
+template <typename Quirks>
 inline void opcode_8XYE(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
+  uint8_t source = Quirks::shift_uses_vy ? cpu.get_vy(opcode) : VX;
 
-  V[0xF] = VX >> 7;
-  VX <<= 1;
+  uint8_t flag = source >> 7;
+
+  // VF last, so that 8FYE leaves the flag
+  VX = source << 1;
+  V[0xF] = flag;
 }
 
 // 9XY0: skip next instruction if VX doesn't equal VY (SNE Vx, Vy)
+template <typename Quirks>
 inline void opcode_9XY0(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
 
   if (VX != VY) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
   }
 }
 
 // ANNN: set I to the address NNN (LD I, addr)
 inline void opcode_ANNN(CPU& cpu, uint16_t opcode) { I = opcode & 0x0FFFu; }
 
-// BNNN: jump to the address NNN plus V0 (JP V0, addr)
+// BNNN: jump to the address NNN plus V0 (JP V0, addr); CHIP-48 and SCHIP
+// read it as BXNN and add VX instead
+template <typename Quirks>
 inline void opcode_BNNN(CPU& cpu, uint16_t opcode) {
-  pc = (opcode & 0x0FFFu) + V[0];
+  uint8_t offset = Quirks::jump_uses_vx ? cpu.get_vx(opcode) : V[0];
+  pc = (opcode & 0x0FFFu) + offset;
 }
 
 // CXNN: set VX to the result of a random byte & NN (RND Vx, byte)
@@ -184,10 +283,14 @@ inline void opcode_CXNN(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t byte = opcode & 0x00FFu;
 
-  VX = cpu.rand_byte(cpu.rand_gen) & byte;
+  VX = cpu.random_byte() & byte;
 }
 
 // DXYN: draw a sprite at position VX, VY with N bytes of sprite data starting
+// at I (DRW Vx, Vy, nibble); pixels past the edges wrap or are clipped
+// with the SUPER-CHIP instructions DXY0 draws a 16x16 sprite of 32 bytes
+// with several XO-CHIP planes selected, the data of each follows the previous
+template <typename Quirks>
 inline void opcode_DXYN(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   uint8_t& VY = cpu.get_vy(opcode);
@@ -195,26 +298,69 @@ inline void opcode_DXYN(CPU& cpu, uint16_t opcode) {
   uint8_t x = VX;
   uint8_t y = VY;
   uint8_t height = opcode & 0x000Fu;
-  const uint8_t* sprite = memory.get_pointer(I);
+  int planes = int(std::bitset<8>(display.get_planes()).count());
 
-  bool collision = display.draw_sprite(x, y, sprite, height);
+  if (Quirks::schip_instructions && height == 0) {
+    uint8_t sprite[32 * Display::PLANES];
+    for (int i = 0; i < 32 * planes; ++i) {
+      sprite[i] = memory.read(I + i);
+    }
+    bool collision =
+        display.draw_sprite16<Quirks::sprites_wrap>(x, y, sprite);
+    V[0xF] = collision ? 1 : 0;
+    return;
+  }
+
+  // gather the rows through read() so sprites near the end of memory wrap
+  // around instead of reading past it
+  uint8_t sprite[16 * Display::PLANES];
+  for (int row = 0; row < height * planes; ++row) {
+    sprite[row] = memory.read(I + row);
+  }
+
+  bool collision =
+      display.draw_sprite<Quirks::sprites_wrap>(x, y, sprite, height);
   V[0xF] = collision ? 1 : 0;
 }
 
 // EX9E: skip next instruction if key with the value of VX is pressed (SKP Vx)
+template <typename Quirks>
 inline void opcode_EX9E(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   if (input.is_key_down(VX)) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
   }
 }
 
 // EXA1: skip next instruction if key with the value of VX is not pressed (SKNP
 // Vx)
+template <typename Quirks>
 inline void opcode_EXA1(CPU& cpu, uint16_t opcode) {
   uint8_t& VX = cpu.get_vx(opcode);
   if (!input.is_key_down(VX)) {
-    pc += 2;
+    skip_next<Quirks>(cpu);
+  }
+}
+
+// F000 NNNN: set I to the 16-bit address in the next word (LD I, long)
+// [XO-CHIP]
+inline void opcode_F000(CPU& cpu) {
+  I = memory.read(pc) << 8 | memory.read(pc + 1);
+  pc += 2;
+}
+
+// FN01: select the bit planes drawn, cleared and scrolled (PLANE n)
+// [XO-CHIP]
+inline void opcode_FN01(CPU& cpu, uint16_t opcode) {
+  display.set_planes((opcode & 0x0F00u) >> 8u);
+}
+
+// F002: load the 16-byte audio pattern from memory at address I (AUDIO)
+// [XO-CHIP]
+inline void opcode_F002(CPU& cpu) {
+  uint8_t* pattern = cpu.get_audio_pattern();
+  for (int i = 0; i < 16; ++i) {
+    pattern[i] = memory.read(I + i);
   }
 }
 
@@ -264,6 +410,13 @@ inline void opcode_FX29(CPU& cpu, uint16_t opcode) {
   I = 0x50 + VX * 0x5;  // 5 bytes per character
 }
 
+// FX30: set I to the big 8x10 sprite of the decimal digit in VX (LD HF, Vx)
+// [SUPER-CHIP]
+inline void opcode_FX30(CPU& cpu, uint16_t opcode) {
+  uint8_t& VX = cpu.get_vx(opcode);
+  I = 0xA0 + (VX & 0xFu) * 10;  // 10 bytes per character
+}
+
 // FX33: store the binary-coded decimal representation of VX at the addresses I,
 // I+1, and I+2 (LD B, Vx)
 inline void opcode_FX33(CPU& cpu, uint16_t opcode) {
@@ -281,23 +434,59 @@ inline void opcode_FX33(CPU& cpu, uint16_t opcode) {
   memory.write(I, VX % 10);
 }
 
+// FX3A: set the audio pattern playback pitch to VX (PITCH Vx) [XO-CHIP]
+inline void opcode_FX3A(CPU& cpu, uint16_t opcode) {
+  cpu.get_pitch() = cpu.get_vx(opcode);
+}
+
+// how far FX55/FX65 move I after storing or loading V0 to VX
+template <typename Quirks>
+inline void advance_index(CPU& cpu, uint8_t x) {
+  if constexpr (Quirks::index_increment == IndexIncrement::x) {
+    I += x;
+  } else if constexpr (Quirks::index_increment ==
+                       IndexIncrement::x_plus_one) {
+    I += x + 1;
+  }
+}
+
 // FX55: store the values of V0 to VX in memory starting at address I (LD [I],
 // Vx)
+template <typename Quirks>
 inline void opcode_FX55(CPU& cpu, uint16_t opcode) {
-  uint8_t& VX = cpu.get_vx(opcode);
+  uint8_t VX = (opcode & 0x0F00u) >> 8u;
 
   for (int i = 0; i <= VX; i++) {
     memory.write(I + i, V[i]);
   }
+  advance_index<Quirks>(cpu, VX);
 }
 
 // FX65: read V0 to VX with values from memory starting at address I (LD Vx,
 // [I])
+template <typename Quirks>
 inline void opcode_FX65(CPU& cpu, uint16_t opcode) {
   uint8_t VX = (opcode & 0x0F00u) >> 8u;
   for (int i = 0; i <= VX; ++i) {
     V[i] = memory.read(I + i);
   }
+  advance_index<Quirks>(cpu, VX);
+}
+
+// FX75: save V0 to VX in the RPL user flags (LD R, Vx) [SUPER-CHIP]
+inline void opcode_FX75(CPU& cpu, uint16_t opcode) {
+  uint8_t VX = (opcode & 0x0F00u) >> 8u;
+  for (int i = 0; i <= VX; ++i) {
+    cpu.get_flags()[i] = V[i];
+  }
+}
+
+// FX85: load V0 to VX from the RPL user flags (LD Vx, R) [SUPER-CHIP]
+inline void opcode_FX85(CPU& cpu, uint16_t opcode) {
+  uint8_t VX = (opcode & 0x0F00u) >> 8u;
+  for (int i = 0; i <= VX; ++i) {
+    V[i] = cpu.get_flags()[i];
+  }
 }
 
 // undefine macros to avoid conflicts
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#include "memory.h"
+#include "opcode_family.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// per-opcode execution profiler: counts executions per opcode family and per
+// pc, and the host time spent in each family
+// only built with -DC8EMU_PROFILE=ON; CPU::step() doesn't reference it at all
+// otherwise
+// reading the cycle counter costs more than most instructions, so only one in
+// every SAMPLE_INTERVAL instructions is timed and the counts are exact
+class Profiler {
+ public:
+  static const uint32_t SAMPLE_INTERVAL = 64;
+
+  Profiler();
+
+  // returns true when the next instruction should be timed
+  bool sample();
+  void count(uint16_t pc, uint16_t opcode);
+  void record(uint16_t pc, uint16_t opcode, uint64_t ticks);
+  void reset();
+
+  // writes a report sorted by host time per family, then the hottest pcs
+  void report(std::ostream& out) const;
+
+  // cheapest available cycle counter (TSC on x86)
+  static uint64_t ticks();
+
+ private:
+  std::array<uint64_t, OPCODE_FAMILY_COUNT> family_counts;
+  std::array<uint64_t, OPCODE_FAMILY_COUNT> family_ticks;
+  std::array<uint64_t, OPCODE_FAMILY_COUNT> family_samples;
+  std::array<uint64_t, Memory::SIZE> pc_counts;
+  uint32_t sample_countdown;
+
+  // used to convert ticks to nanoseconds
+  uint64_t start_ticks;
+  std::chrono::steady_clock::time_point start_time;
+};
+
+inline uint64_t Profiler::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+inline bool Profiler::sample() {
+  if (--sample_countdown != 0) {
+    return false;
+  }
+  sample_countdown = SAMPLE_INTERVAL;
+  return true;
+}
+
+inline void Profiler::count(uint16_t pc, uint16_t opcode) {
+  ++family_counts[opcode_family(opcode)];
+  ++pc_counts[pc & Memory::ADDRESS_MASK];
+}
+
+inline void Profiler::record(uint16_t pc, uint16_t opcode, uint64_t ticks) {
+  OpcodeFamily family = opcode_family(opcode);
+  ++family_counts[family];
+  family_ticks[family] += ticks;
+  ++family_samples[family];
+  ++pc_counts[pc & Memory::ADDRESS_MASK];
+}
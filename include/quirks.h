@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Memory;
+
+// CHIP-8 variants disagree on a handful of instructions; each profile below
+// describes one of them with compile-time constants, and the interpreter is
+// instantiated once per profile so the checks fold away
+enum class QuirkProfile : uint8_t {
+  cosmac_vip,  // the original interpreter
+  chip48,      // HP-48 port
+  schip,       // SUPER-CHIP 1.1
+  xo_chip,
+};
+
+// where FX55/FX65 leave I
+enum class IndexIncrement : uint8_t {
+  none,        // I is unchanged
+  x,           // I += X
+  x_plus_one,  // I += X + 1, past the last register stored or loaded
+};
+
+struct CosmacVipQuirks {
+  static constexpr bool logic_resets_vf = true;  // 8XY1, 8XY2, 8XY3
+  static constexpr bool shift_uses_vy = true;    // 8XY6, 8XYE shift VY
+  static constexpr IndexIncrement index_increment = IndexIncrement::x_plus_one;
+  static constexpr bool jump_uses_vx = false;  // BXNN jumps to XNN + VX
+  static constexpr bool sprites_wrap = false;  // instead of clipping at edges
+  // 00CN, 00FB-00FF, DXY0, FX30, FX75, FX85 and the 128x64 mode
+  static constexpr bool schip_instructions = false;
+  // 00DN, 5XY2, 5XY3, F000 NNNN, FN01, F002, FX3A, skips over F000 NNNN
+  static constexpr bool xo_chip_instructions = false;
+};
+
+struct Chip48Quirks {
+  static constexpr bool logic_resets_vf = false;
+  static constexpr bool shift_uses_vy = false;
+  static constexpr IndexIncrement index_increment = IndexIncrement::x;
+  static constexpr bool jump_uses_vx = true;
+  static constexpr bool sprites_wrap = false;
+  static constexpr bool schip_instructions = false;
+  static constexpr bool xo_chip_instructions = false;
+};
+
+struct SchipQuirks {
+  static constexpr bool logic_resets_vf = false;
+  static constexpr bool shift_uses_vy = false;
+  static constexpr IndexIncrement index_increment = IndexIncrement::none;
+  static constexpr bool jump_uses_vx = true;
+  static constexpr bool sprites_wrap = false;
+  static constexpr bool schip_instructions = true;
+  static constexpr bool xo_chip_instructions = false;
+};
+
+struct XoChipQuirks {
+  static constexpr bool logic_resets_vf = false;
+  static constexpr bool shift_uses_vy = true;
+  static constexpr IndexIncrement index_increment = IndexIncrement::x_plus_one;
+  static constexpr bool jump_uses_vx = false;
+  static constexpr bool sprites_wrap = true;
+  static constexpr bool schip_instructions = true;
+  static constexpr bool xo_chip_instructions = true;
+};
+
+// calls visit with a value of the profile's quirks type, so that code
+// templated on the quirks can be picked at run time with a single switch
+template <typename Visitor>
+inline decltype(auto) with_quirks(QuirkProfile profile, Visitor&& visit) {
+  switch (profile) {
+    case QuirkProfile::chip48:
+      return visit(Chip48Quirks());
+    case QuirkProfile::schip:
+      return visit(SchipQuirks());
+    case QuirkProfile::xo_chip:
+      return visit(XoChipQuirks());
+    case QuirkProfile::cosmac_vip:
+    default:
+      return visit(CosmacVipQuirks());
+  }
+}
+
+// names as accepted on the command line: vip, chip48, schip, xochip
+const char* quirk_profile_name(QuirkProfile profile);
+bool parse_quirk_profile(const std::string& name, QuirkProfile& profile);
+
+// guesses the profile of the loaded ROM from the instructions its reachable
+// code uses: XO-CHIP or SUPER-CHIP extensions select those profiles, anything
+// else runs as COSMAC VIP (CHIP-48 programs can't be told apart from it)
+QuirkProfile detect_quirk_profile(const Memory& memory);
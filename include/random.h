@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+// source of random bytes for CXNN
+// the whole generator state must fit in 64 bits so it can be stored in save
+// states, which keeps replays and run-ahead bit-exact
+class RandomSource {
+ public:
+  virtual ~RandomSource() = default;
+  virtual void seed(uint64_t seed) = 0;
+  virtual uint8_t next_byte() = 0;
+  virtual uint64_t get_state() const = 0;
+  virtual void set_state(uint64_t state) = 0;
+};
+
+// default generator: PCG32 (XSH RR variant) on a fixed stream
+class Pcg32 : public RandomSource {
+ public:
+  explicit Pcg32(uint64_t seed = 0) { Pcg32::seed(seed); }
+
+  void seed(uint64_t seed) override {
+    state = 0;
+    next();
+    state += seed;
+    next();
+  }
+
+  uint32_t next() {
+    uint64_t old = state;
+    state = old * 6364136223846793005ull + INCREMENT;
+    uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = uint32_t(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+  }
+
+  // the high bits are the best distributed ones
+  uint8_t next_byte() override { return uint8_t(next() >> 24u); }
+
+  uint64_t get_state() const override { return state; }
+  void set_state(uint64_t new_state) override { state = new_state; }
+
+ private:
+  static const uint64_t INCREMENT = 1442695040888963407ull;
+  uint64_t state;
+};
+
+// xorshift64* alternative, for comparing against other emulators using it
+class Xorshift64 : public RandomSource {
+ public:
+  explicit Xorshift64(uint64_t seed = 0) { Xorshift64::seed(seed); }
+
+  // a zero state would get stuck, so seeds are offset by a nonzero constant
+  void seed(uint64_t seed) override {
+    state = seed ^ 0x9E3779B97F4A7C15ull;
+    if (state == 0) {
+      state = 1;
+    }
+  }
+
+  uint8_t next_byte() override {
+    state ^= state >> 12u;
+    state ^= state << 25u;
+    state ^= state >> 27u;
+    return uint8_t((state * 0x2545F4914F6CDD1Dull) >> 56u);
+  }
+
+  uint64_t get_state() const override { return state; }
+  void set_state(uint64_t new_state) override { state = new_state; }
+
+ private:
+  uint64_t state;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+#include "memory.h"
+#include "rom_library.h"
+
+// many ROMs and their metadata in one file, for shipping a collection to a
+// host: the bundle is memory-mapped and any ROM is found by name or content
+// hash and loaded straight out of the mapping, with no filesystem walk
+//
+// file layout (little endian):
+//   "C8BN", u16 version, u16 entry size, u32 ROM count, u32 payload
+//   alignment, u32 string offset, u32 string bytes, u64 file size,
+//   then one entry per ROM sorted by name:
+//     u64 content hash (Memory::get_rom_hash()), u32 payload offset,
+//     u32 payload size, u8 platform, 15 bytes padding, then (u32 offset,
+//     u32 length) into the strings for the name, title, credits and summary
+//   then the strings, then the payloads, each starting on a multiple of the
+//   alignment
+class RomBundle {
+ public:
+  static const uint32_t PAYLOAD_ALIGNMENT = 64;
+
+  // one ROM for write(); name is how it is looked up, usually its path
+  // relative to the packed directory
+  struct Rom {
+    std::string name;
+    RomMetadata metadata;
+    std::vector<uint8_t> data;
+  };
+
+  // writes a bundle of the ROMs (sorted by name, which must be unique)
+  static bool write(const std::string& filename, std::vector<Rom> roms);
+
+  // maps a bundle and checks its structure; false, with the reason on
+  // std::cerr, if it isn't a valid one
+  bool open(const std::string& filename);
+  void close();
+
+  size_t size() const;
+  // the strings point into the mapping, path is the name
+  RomInfo get(size_t i) const;
+  const uint8_t* get_payload(size_t i) const;
+
+  // index of the ROM, or size() if there is none
+  size_t find(std::string_view name) const;
+  size_t find(uint64_t rom_hash) const;
+
+  // loads ROM i into memory after checking it against its content hash
+  bool load(size_t i, Memory& memory, RomError* error = nullptr) const;
+
+ private:
+  static const uint16_t VERSION = 1;
+  static const size_t HEADER_SIZE = 32;
+  static const size_t ENTRY_SIZE = 64;
+
+  const uint8_t* entry(size_t i) const;
+  std::string_view string_at(const uint8_t* field) const;
+
+  MappedFile file;
+  std::string filename;
+  size_t count = 0;
+  const char* strings = nullptr;
+};
+
+inline size_t RomBundle::size() const { return count; }
+inline const uint8_t* RomBundle::entry(size_t i) const {
+  return file.data() + HEADER_SIZE + i * ENTRY_SIZE;
+}
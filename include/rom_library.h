@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+#include "memory.h"
+#include "quirks.h"
+
+// what the library knows about one ROM; the strings point into the index and
+// stay valid until it is updated or closed
+struct RomInfo {
+  std::string_view path;     // relative to the library directory
+  std::string_view title;    // the file name without the credits
+  std::string_view credits;  // the "[...]" part of the file name
+  std::string_view summary;  // first line of the .txt sidecar, if any
+  uint64_t rom_hash;         // same as Memory::get_rom_hash()
+  uint32_t size;
+  QuirkProfile platform;  // detected from the instructions used
+};
+
+// the same with the strings owned, while the ROM is being read
+struct RomMetadata {
+  std::string title;
+  std::string credits;
+  std::string summary;
+  uint64_t rom_hash = 0;
+  uint32_t size = 0;
+  QuirkProfile platform = QuirkProfile::cosmac_vip;
+
+  // views into this, without a path
+  RomInfo info() const;
+};
+
+// true for the extensions of ROM images: .ch8, .c8, .sc8 and .xo8
+bool is_rom_file(const std::string& path);
+
+// what the library keeps about the ROM image found at rom_path (already
+// read into data) and its .txt sidecar, if there is one; false, with the
+// reason in error, if the image can't be loaded
+bool describe_rom(const std::string& rom_path, const uint8_t* data,
+                  size_t size, RomMetadata& metadata,
+                  RomError* error = nullptr);
+
+struct LibraryScanStats {
+  size_t roms = 0;
+  size_t reused = 0;   // unchanged since the index was written
+  size_t read = 0;     // new or changed, read and parsed again
+  size_t skipped = 0;  // unreadable or too large for the memory
+  bool written = false;
+  double seconds = 0.0;
+};
+
+// index of a directory tree of ROM images (.ch8, .c8, .sc8, .xo8) and their
+// .txt sidecars, for launchers
+// the index is a single file that is memory-mapped as is, so opening it
+// parses nothing; update() compares every ROM's size and modification time
+// (and its sidecar's) with the index and only reads the files that changed,
+// so a rescan of an unchanged library is a directory walk
+//
+// file layout (little endian):
+//   "C8LI", u16 version, u16 record size, u32 ROM count, u32 string bytes,
+//   then one record per ROM sorted by path:
+//     u64 ROM hash, u64 ROM mtime, u64 sidecar mtime (0: none), u32 size,
+//     u8 platform, 3 bytes padding, then (u32 offset, u32 length) into the
+//     strings for the path, title, credits and summary
+//   then the strings
+class RomLibrary {
+ public:
+  // index file name used inside the library directory
+  static constexpr const char* DEFAULT_INDEX = ".c8library";
+
+  // maps an existing index; false if there is none or it isn't valid, in
+  // which case the library is empty and update() builds it from scratch
+  bool open(const std::string& index_file);
+  void close();
+
+  // brings the index in line with the ROMs under directory, rewriting (and
+  // remapping) index_file only if something changed; the index is opened
+  // first if it isn't already
+  bool update(const std::string& directory, const std::string& index_file,
+              LibraryScanStats* stats = nullptr);
+
+  size_t size() const;
+  RomInfo get(size_t i) const;
+  // the first ROM with this content, false if there is none
+  bool find(uint64_t rom_hash, RomInfo& info) const;
+
+ private:
+  static const uint16_t VERSION = 1;
+  static const size_t HEADER_SIZE = 16;
+  static const size_t RECORD_SIZE = 64;
+
+  const uint8_t* record(size_t i) const;
+  std::string_view string_at(const uint8_t* field) const;
+  // index of the record for path, or size() if there is none
+  size_t find_path(std::string_view path) const;
+
+  MappedFile index;
+  size_t count = 0;
+  const char* strings = nullptr;
+};
+
+inline RomInfo RomMetadata::info() const {
+  return {std::string_view(), title, credits, summary, rom_hash, size,
+          platform};
+}
+
+inline size_t RomLibrary::size() const { return count; }
+inline const uint8_t* RomLibrary::record(size_t i) const {
+  return index.data() + HEADER_SIZE + i * RECORD_SIZE;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+// per-ROM settings found by calibration, keyed by the ROM's content hash so
+// renamed or moved copies still find theirs
+// the file is plain text, one ROM per line: the hash in hex and the
+// instructions per frame; lines starting with '#' are comments
+struct RomProfile {
+  int instructions_per_frame;
+};
+
+class RomProfiles {
+ public:
+  // used by the emulator and the calibration tool unless told otherwise
+  static constexpr const char* DEFAULT_FILE = "c8emu_profiles.txt";
+
+  // a missing file is an empty set of profiles, not an error
+  bool load(const char* filename);
+  bool save(const char* filename) const;
+
+  // nullptr if the ROM has no profile
+  const RomProfile* find(uint64_t rom_hash) const;
+  void set(uint64_t rom_hash, const RomProfile& profile);
+
+ private:
+  std::map<uint64_t, RomProfile> profiles;
+};
+
+inline const RomProfile* RomProfiles::find(uint64_t rom_hash) const {
+  auto it = profiles.find(rom_hash);
+  return it != profiles.end() ? &it->second : nullptr;
+}
+inline void RomProfiles::set(uint64_t rom_hash, const RomProfile& profile) {
+  profiles[rom_hash] = profile;
+}
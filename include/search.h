@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CPU.h"
+#include "snapshot.h"
+
+// state-space search over keypad inputs, used to find input sequences that
+// drive a ROM into a goal state (regression inputs, speedrun paths)
+// every node holds the keypad steady for a few frames; workers share a single
+// frontier and a VisitedSet so equivalent states are only expanded once
+// the search tree keeps only each node's parent and keys, and queued states
+// are stored as their difference from the root
+struct SearchOptions {
+  enum class Strategy { breadth_first, best_first };
+
+  Strategy strategy = Strategy::breadth_first;
+
+  // key masks tried from every node (empty = no key, then each single key)
+  std::vector<uint16_t> inputs;
+
+  int instructions_per_frame = 10;
+  QuirkProfile quirks = QuirkProfile::cosmac_vip;
+  int frames_per_input = 4;
+  int max_depth = 64;
+  size_t max_states = 1000000;
+  // bytes held by the queued states and the search tree; the search stops
+  // when it is exceeded (the visited set isn't counted)
+  size_t max_memory = size_t(1) << 30;
+  unsigned threads = 0;  // 0 = one per hardware thread
+
+  // goal predicate, evaluated on every new state
+  std::function<bool(CPU&)> goal;
+
+  // best-first priority, higher is expanded first (depth is used if unset)
+  std::function<int64_t(CPU&)> score;
+};
+
+struct SearchResult {
+  bool found = false;
+  std::vector<uint16_t> inputs;  // key mask for each step from the root
+  size_t states_expanded = 0;
+  size_t states_visited = 0;
+  size_t peak_memory = 0;      // in the frontier and the tree, see max_memory
+  bool out_of_memory = false;  // stopped by max_memory
+  double seconds = 0.0;
+};
+
+SearchResult search(const Snapshot& root, const SearchOptions& options);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "display.h"
+#include "memory.h"
+
+// full copy of the machine state, cheap enough to take once per search node
+struct Snapshot {
+  Memory::Data memory;
+  uint64_t memory_hash;
+  Display::Screen screen;
+  uint64_t screen_hash;
+  bool hires;
+  uint8_t planes;
+
+  std::array<uint8_t, 16> V;
+  uint16_t I;
+  uint16_t pc;
+  uint8_t sp;
+  std::array<uint16_t, 16> stack;
+  uint8_t delay_timer;
+  uint8_t sound_timer;
+  uint64_t random_state;
+  std::array<uint8_t, 16> flags;
+  std::array<uint8_t, 16> audio_pattern;
+  uint8_t pitch;
+
+  uint16_t keys;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// lock-free single-producer single-consumer ring buffer
+// push() never blocks: it fails when the queue is full, so the producer (the
+// emulation thread) is never held up by a slow consumer
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+
+ public:
+  bool push(const T& value) {
+    size_t tail_position = tail.load(std::memory_order_relaxed);
+    if (tail_position - head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    items[tail_position & (Capacity - 1)] = value;
+    tail.store(tail_position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& value) {
+    size_t head_position = head.load(std::memory_order_relaxed);
+    if (head_position == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = items[head_position & (Capacity - 1)];
+    head.store(head_position + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::array<T, Capacity> items;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit mixing function (splitmix64 finalizer)
+// used to derive the Zobrist-style keys for the machine state hash
+inline uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30u)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27u)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31u);
+}
+
+// key for a byte stored at a memory address
+// zero bytes contribute nothing, so cleared memory hashes to 0
+inline uint64_t memory_key(uint16_t address, uint8_t value) {
+  return value ? mix64((uint64_t(address) << 8u) | value) : 0;
+}
+
+// key for a lit pixel on the screen (in one of the XO-CHIP bit planes)
+inline uint64_t pixel_key(int x, int y, int plane = 0) {
+  return mix64(0xD15B1A7000000000ull | (uint64_t(plane) << 32u) |
+               (uint64_t(y) << 16u) | uint64_t(x));
+}
+
+// content hash of a byte buffer (ROM images, framebuffers)
+inline uint64_t hash_bytes(const uint8_t* data, size_t size) {
+  uint64_t hash = mix64(size);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001B3ull;
+  }
+  return mix64(hash);
+}
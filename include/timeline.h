@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// host timeline tracing: scoped events recorded into per-thread buffers and
+// exported in the Chrome trace event format (chrome://tracing, Perfetto)
+// recording is off by default, a disabled scope costs one relaxed load
+namespace timeline {
+
+extern std::atomic<bool> enabled;
+
+void enable();
+uint64_t now_ns();
+void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+bool write_chrome_trace(const char* filename);
+
+// records an event covering its own lifetime; the name must be a string
+// literal (or otherwise outlive the export)
+class Scope {
+ public:
+  explicit Scope(const char* name)
+      : name(enabled.load(std::memory_order_relaxed) ? name : nullptr),
+        start_ns(this->name ? now_ns() : 0) {}
+
+  ~Scope() {
+    if (name) {
+      record(name, start_ns, now_ns());
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  const char* name;
+  uint64_t start_ns;
+};
+
+}  // namespace timeline
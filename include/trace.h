@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one executed instruction, packed in 16 bytes
+struct TraceRecord {
+  enum Flags : uint8_t {
+    I_CHANGED = 0x01,
+    TRUNCATED = 0x02,  // more registers changed than fit in values
+  };
+
+  uint16_t pc;
+  uint16_t opcode;
+  uint16_t changed;  // bit N set: VN changed
+  uint16_t I;        // I after the instruction
+  uint8_t sp;
+  uint8_t flags;
+  uint8_t values[6];  // new values of the changed registers, lowest first
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay packed");
+
+// per-machine ring buffer of the last executed instructions
+// the emulation thread is the only writer and never blocks or allocates;
+// dumps taken from other threads may see the records being overwritten
+//
+// dump layout: "C8TR", u16 version, u16 record size, u32 record count, then
+// the records oldest first, in host byte order
+class ExecutionTrace {
+ public:
+  explicit ExecutionTrace(size_t capacity_log2 = 16);
+
+  void record(uint16_t pc, uint16_t opcode, const uint8_t* V_before,
+              const uint8_t* V_after, uint16_t I_before, uint16_t I_after,
+              uint8_t sp);
+
+  size_t size() const;
+  bool dump(const char* filename) const;
+
+  // dumps to the given file the first time an anomaly (such as an unknown
+  // opcode) is reported; the dump is taken once the instruction that caused
+  // it has been recorded, so it ends with that instruction
+  void set_anomaly_file(const char* filename);
+  void anomaly();
+
+  static bool load(const char* filename, std::vector<TraceRecord>& records);
+
+ private:
+  static const uint16_t VERSION = 1;
+
+  std::vector<TraceRecord> records;
+  size_t mask;
+  std::atomic<uint64_t> head;
+
+  void dump_anomaly();
+
+  std::string anomaly_file;
+  bool anomaly_pending;
+  bool anomaly_dumped;
+};
+
+inline void ExecutionTrace::record(uint16_t pc, uint16_t opcode,
+                                   const uint8_t* V_before,
+                                   const uint8_t* V_after, uint16_t I_before,
+                                   uint16_t I_after, uint8_t sp) {
+  TraceRecord entry;
+  entry.pc = pc;
+  entry.opcode = opcode;
+  entry.changed = 0;
+  entry.I = I_after;
+  entry.sp = sp;
+  entry.flags = I_before != I_after ? TraceRecord::I_CHANGED : 0;
+
+  int stored = 0;
+  for (int reg = 0; reg < 16; ++reg) {
+    if (V_before[reg] != V_after[reg]) {
+      entry.changed |= 1u << reg;
+      if (stored < 6) {
+        entry.values[stored++] = V_after[reg];
+      } else {
+        entry.flags |= TraceRecord::TRUNCATED;
+      }
+    }
+  }
+
+  uint64_t position = head.load(std::memory_order_relaxed);
+  records[position & mask] = entry;
+  head.store(position + 1, std::memory_order_release);
+
+  if (anomaly_pending) {
+    dump_anomaly();
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class CPU;
+
+// machine events at absolute cycle counts, handed out earliest first (events
+// due on the same cycle in the order they were scheduled)
+class EventScheduler {
+ public:
+  enum class Event : uint8_t {
+    interrupt,    // 60 Hz display interrupt: timers tick, the frame ends
+    display_end,  // the interrupt routine gives the CPU back
+  };
+
+  void schedule(uint64_t cycle, Event event);
+  void clear();
+  bool empty() const;
+
+  // cycle of the earliest event (the scheduler must not be empty)
+  uint64_t next_cycle() const;
+  Event pop();
+
+ private:
+  struct Entry {
+    uint64_t cycle;
+    uint64_t order;
+    Event event;
+  };
+
+  static bool later(const Entry& a, const Entry& b);
+
+  // binary min-heap on (cycle, order)
+  std::vector<Entry> heap;
+  uint64_t scheduled = 0;
+};
+
+// COSMAC VIP timing: instead of a fixed number of instructions per frame,
+// every instruction takes the machine cycles its routine in the original
+// interpreter takes (estimated for now, see vip_timing.cpp), and frames are
+// the 60 Hz display interrupts
+// the CDP1802 runs a machine cycle every 8 clocks at 1.7609 MHz and the CDP1861
+// raises an interrupt every 262 lines of 14 cycles; the CHIP-8 interrupt
+// routine keeps the CPU for the 128 displayed lines (the display DMA and the
+// repetition of every row), so only the rest of the frame runs the program
+// an instruction cut by the interrupt finishes once the CPU is given back,
+// and DXYN first waits for the next interrupt, so sprites are drawn at most
+// once a frame, right after the display
+// FX0A waits for a key press like everywhere else, then also for its release
+// before the program goes on, as the VIP keypad routine does
+// run_frame() runs the program up to the next interrupt and ticks the timers
+// there, so it can stand in for CPU::run_frame() anywhere
+class VipTiming {
+ public:
+  static const uint32_t CYCLES_PER_LINE = 14;
+  static const uint32_t FRAME_CYCLES = 262 * CYCLES_PER_LINE;
+  // two lines from the interrupt to the first displayed one, then 128 lines
+  static const uint32_t DISPLAY_CYCLES = 130 * CYCLES_PER_LINE;
+
+  explicit VipTiming(CPU& cpu);
+
+  // starts over at the first frame, with the CPU given back as after a
+  // display; call it after initializing the CPU or loading a snapshot
+  void reset();
+
+  // runs the program up to the next interrupt and ends the frame there
+  void run_frame();
+
+  // machine cycles the instruction takes when executed in the current state
+  // (skips taken, sprite position and height, BCD digits and so on)
+  uint32_t instruction_cycles(uint16_t opcode) const;
+
+  uint64_t get_cycle() const;
+  uint64_t get_frame() const;
+  uint64_t get_instructions() const;
+
+ private:
+  static const uint8_t NO_KEY = 0xFF;
+
+  void execute();
+
+  CPU& cpu;
+  EventScheduler scheduler;
+  uint64_t cycle;  // when the instruction in progress completes
+  uint64_t frame;
+  uint64_t instructions;
+  uint64_t interrupted;  // cycles of the instruction cut by the interrupt
+  bool stalled;          // the interrupt routine holds the CPU
+  bool waiting;          // DXYN waits for the next interrupt
+  bool draw_ready;       // ... which came, the sprite can be drawn
+  bool idle;             // FX0A spins until the keys change
+  uint8_t held_key;      // FX0A waits for this key to be released
+};
+
+inline bool EventScheduler::empty() const { return heap.empty(); }
+inline uint64_t EventScheduler::next_cycle() const { return heap[0].cycle; }
+
+inline uint64_t VipTiming::get_cycle() const { return cycle; }
+inline uint64_t VipTiming::get_frame() const { return frame; }
+inline uint64_t VipTiming::get_instructions() const { return instructions; }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// thread-safe set of machine state hashes, used to deduplicate states during
+// tree searches (BFS, MCTS) run from several worker threads
+// the set is split into independently locked shards picked by the top bits of
+// the hash, so workers rarely contend on the same lock
+class VisitedSet {
+ public:
+  explicit VisitedSet(size_t shard_bits = 6);
+
+  // returns true if the hash was not in the set yet
+  bool insert(uint64_t hash);
+  bool contains(uint64_t hash) const;
+  size_t size() const;
+  void clear();
+
+ private:
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::unordered_set<uint64_t> hashes;
+  };
+
+  Shard& shard_for(uint64_t hash) const;
+
+  size_t shard_bits;
+  mutable std::vector<Shard> shards;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio.h"
+
+// audio sink that captures the samples to a 16-bit mono WAV file, for
+// checking sound behavior without an audio device
+// write() only appends to an in-memory block; full blocks (a few seconds of
+// sound each) are handed to a background thread that converts and writes
+// them, so capture keeps up with emulation running far faster than real time
+// nothing is ever dropped: if the disk falls behind by more than
+// MAX_PENDING_BLOCKS, write() waits for it
+// the RIFF sizes are 32-bit, so capture stops at MAX_SAMPLES (about 13.5
+// hours at 44.1 kHz) with a message rather than wrapping them
+class WavWriter : public AudioSink {
+ public:
+  static const size_t BLOCK_SAMPLES = 1 << 17;
+  static const size_t MAX_PENDING_BLOCKS = 8;
+  static const uint64_t MAX_SAMPLES = (UINT32_MAX - 36) / 2;
+
+  WavWriter();
+  ~WavWriter() override;
+
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator=(const WavWriter&) = delete;
+
+  // creates the file and starts the writer thread
+  bool open(const std::string& filename, int sample_rate);
+
+  void write(const int16_t* samples, size_t count) override;
+
+  // writes what is left, completes the header and closes the file; returns
+  // false if any write failed or the sound was cut at MAX_SAMPLES
+  bool close();
+
+  uint64_t get_sample_count() const;
+
+ private:
+  void run();
+  void submit_block();
+
+  std::ofstream file;
+  std::string filename;
+  int sample_rate = 0;
+  uint64_t sample_count = 0;
+  bool truncated = false;
+
+  // owned by the emulation thread
+  std::vector<int16_t> block;
+
+  // shared with the writer thread
+  std::mutex mutex;
+  std::condition_variable wake;  // a block is pending, or stopping
+  std::condition_variable done;  // a block was written
+  std::deque<std::vector<int16_t>> pending;
+  std::vector<std::vector<int16_t>> spare;  // written blocks, for reuse
+  bool stopping = false;
+  bool failed = false;
+  std::thread writer;
+};
+
+inline uint64_t WavWriter::get_sample_count() const { return sample_count; }
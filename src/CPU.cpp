@@ -3,21 +3,27 @@
 #include <stdint.h>
 
 #include <chrono>
-#include <iostream>
-#include <random>
+#include <cstring>
 
 #include "display.h"
 #include "opcodes.h"
+#include "state_hash.h"
 
 CPU::CPU(Memory& memory, Display& display, Input& input)
     : memory(memory),
       display(display),
       input(input),
-      rand_gen(std::chrono::system_clock::now().time_since_epoch().count()) {
-  rand_byte = std::uniform_int_distribution<uint8_t>(0, 255);
+      random(std::make_unique<Pcg32>(
+          std::chrono::system_clock::now().time_since_epoch().count())) {
   initialize();
 }
 
+void CPU::seed(uint64_t seed) { random->seed(seed); }
+
+void CPU::set_random_source(std::unique_ptr<RandomSource> source) {
+  random = std::move(source);
+}
+
 void CPU::initialize() {
   pc = 0x200;  // program counter starts at 0x200
   I = 0;       // reset index register
@@ -30,28 +36,222 @@ void CPU::initialize() {
   // clear timers
   delay_timer = 0;
   sound_timer = 0;
+  sound_playing = false;
+
+  flags.fill(0);
+  audio_pattern.fill(0);
+  pitch = 64;
+  display.set_planes(1);
+
+  halted = false;
+  update_instrumented();
 }
 
 void CPU::cycle() {
+  step();
+  update_timers();
+}
+
+void CPU::step() {
+  with_quirks(quirks, [this](auto profile) { step_as<decltype(profile)>(); });
+}
+
+template <typename Quirks>
+void CPU::step_as() {
   // fetch instruction
   uint16_t opcode = memory.read(pc) << 8 | memory.read(pc + 1);
 
+  // tracing and profiling take a separate path so that the plain one only
+  // pays for this branch
+  if (instrumented) {
+    instrumented_step<Quirks>(opcode);
+    return;
+  }
+
   // decode and execute
   pc += 2;
-  process_opcode(opcode);
+  process_opcode<Quirks>(opcode);
+}
+
+template <typename Quirks>
+void CPU::instrumented_step(uint16_t opcode) {
+  if (halted) {
+    return;
+  }
+
+  uint16_t opcode_pc = pc;
+  std::array<uint8_t, 16> V_before = V;
+  uint16_t I_before = I;
+
+#ifdef C8EMU_PROFILE
+  if (call_graph) {
+    call_graph->execute(opcode);
+  }
+  bool timed = profiler && profiler->sample();
+  uint64_t start_ticks = timed ? Profiler::ticks() : 0;
+#endif
+
+  pc += 2;
+  process_opcode<Quirks>(opcode);
+
+#ifdef C8EMU_PROFILE
+  if (timed) {
+    profiler->record(opcode_pc, opcode, Profiler::ticks() - start_ticks);
+  } else if (profiler) {
+    profiler->count(opcode_pc, opcode);
+  }
+#endif
 
+  if (trace) {
+    trace->record(opcode_pc, opcode, V_before.data(), V.data(), I_before, I,
+                  sp);
+  }
+}
+
+void CPU::update_instrumented() {
+  bool attached = trace != nullptr;
+#ifdef C8EMU_PROFILE
+  attached = attached || profiler || call_graph;
+#endif
+  instrumented = halted || (attached && !replaying);
+}
+
+void CPU::report_unknown_opcode(uint16_t opcode) {
+  uint16_t opcode_pc = pc - 2;
+
+  // already counted and reported the first time through
+  if (!replaying) {
+    ++unknown_opcodes;
+    if (unknown_opcode_policy != UnknownOpcodePolicy::skip && diagnostics) {
+      diagnostics->report(AnomalyKind::unknown_opcode, opcode_pc, opcode);
+    }
+    if (trace) {
+      trace->anomaly();
+    }
+  }
+
+  if (unknown_opcode_policy == UnknownOpcodePolicy::halt) {
+    // stay on the opcode so the state can be inspected
+    halt();
+  }
+}
+
+void CPU::halt() {
+  pc -= 2;
+  halted = true;
+  update_instrumented();
+}
+
+void CPU::update_timers() {
   if (delay_timer > 0) {
     --delay_timer;
   }
 
+  // the audio output renders each frame from this (see audio.h)
+  sound_playing = sound_timer > 0;
   if (sound_timer > 0) {
-    if (sound_timer == 1) {
-      // TODO: play sound
-    }
     --sound_timer;
   }
 }
 
+void CPU::run_frame(int instructions) {
+  // the profile is picked once per frame rather than once per instruction
+  with_quirks(quirks, [&](auto profile) {
+    for (int i = 0; i < instructions; ++i) {
+      step_as<decltype(profile)>();
+    }
+  });
+  end_frame();
+}
+
+void CPU::end_frame() {
+  update_timers();
+
+  // hand coalesced anomaly reports to the logger between frames
+  if (diagnostics) {
+    diagnostics->flush_if_idle();
+  }
+}
+
+void CPU::save_snapshot(Snapshot& snapshot) const {
+  snapshot.memory = memory.get_data();
+  snapshot.memory_hash = memory.get_hash();
+  snapshot.screen = display.get_screen();
+  snapshot.screen_hash = display.get_hash();
+  snapshot.hires = display.is_hires();
+  snapshot.planes = display.get_planes();
+
+  snapshot.V = V;
+  snapshot.I = I;
+  snapshot.pc = pc;
+  snapshot.sp = sp;
+  snapshot.stack = stack;
+  snapshot.delay_timer = delay_timer;
+  snapshot.sound_timer = sound_timer;
+  snapshot.random_state = random->get_state();
+  snapshot.flags = flags;
+  snapshot.audio_pattern = audio_pattern;
+  snapshot.pitch = pitch;
+
+  snapshot.keys = input.get_keys();
+}
+
+void CPU::load_snapshot(const Snapshot& snapshot) {
+  memory.restore(snapshot.memory, snapshot.memory_hash);
+  display.restore(snapshot.screen, snapshot.screen_hash, snapshot.hires,
+                  snapshot.planes);
+
+  V = snapshot.V;
+  I = snapshot.I;
+  pc = snapshot.pc;
+  sp = snapshot.sp;
+  stack = snapshot.stack;
+  delay_timer = snapshot.delay_timer;
+  sound_timer = snapshot.sound_timer;
+  random->set_state(snapshot.random_state);
+  flags = snapshot.flags;
+  audio_pattern = snapshot.audio_pattern;
+  pitch = snapshot.pitch;
+
+  input.set_keys(snapshot.keys);
+
+  halted = false;
+  update_instrumented();
+}
+
+uint64_t CPU::state_hash() const {
+  // memory and framebuffer hashes are maintained incrementally, so only the
+  // registers need to be folded in here
+  uint64_t hash = memory.get_hash() ^ mix64(display.get_hash());
+
+  uint64_t word;
+  for (size_t i = 0; i < V.size(); i += sizeof(word)) {
+    std::memcpy(&word, &V[i], sizeof(word));
+    hash = mix64(hash ^ word);
+  }
+  for (size_t i = 0; i < stack.size(); i += sizeof(word) / 2) {
+    std::memcpy(&word, &stack[i], sizeof(word));
+    hash = mix64(hash ^ word);
+  }
+  for (size_t i = 0; i < flags.size(); i += sizeof(word)) {
+    std::memcpy(&word, &flags[i], sizeof(word));
+    hash = mix64(hash ^ word);
+  }
+  for (size_t i = 0; i < audio_pattern.size(); i += sizeof(word)) {
+    std::memcpy(&word, &audio_pattern[i], sizeof(word));
+    hash = mix64(hash ^ word);
+  }
+
+  word = uint64_t(I) | uint64_t(pc) << 16u | uint64_t(sp) << 32u |
+         uint64_t(delay_timer) << 40u | uint64_t(sound_timer) << 48u |
+         uint64_t(pitch) << 56u;
+  hash = mix64(hash ^ word);
+
+  // states that only differ in their generator still have different futures
+  return mix64(hash ^ random->get_state());
+}
+
+template <typename Quirks>
 void CPU::process_opcode(uint16_t opcode) {
   switch (opcode & 0xF000) {
     case 0x0000:
@@ -63,7 +263,7 @@ void CPU::process_opcode(uint16_t opcode) {
           opcode_00EE(*this);
           break;
         default:
-          std::cerr << "Unknown opcode [0x0000]: " << opcode << std::endl;
+          process_extended_opcode<Quirks>(opcode);
           break;
       }
       break;
@@ -74,13 +274,15 @@ void CPU::process_opcode(uint16_t opcode) {
       opcode_2NNN(*this, opcode);
       break;
     case 0x3000:
-      opcode_3XNN(*this, opcode);
+      opcode_3XNN<Quirks>(*this, opcode);
       break;
     case 0x4000:
-      opcode_4XNN(*this, opcode);
+      opcode_4XNN<Quirks>(*this, opcode);
       break;
     case 0x5000:
-      opcode_5XY0(*this, opcode);
+      if (!Quirks::xo_chip_instructions || !process_xo_chip_opcode(opcode)) {
+        opcode_5XY0<Quirks>(*this, opcode);
+      }
       break;
     case 0x6000:
       opcode_6XNN(*this, opcode);
@@ -94,13 +296,13 @@ void CPU::process_opcode(uint16_t opcode) {
           opcode_8XY0(*this, opcode);
           break;
         case 0x0001:
-          opcode_8XY1(*this, opcode);
+          opcode_8XY1<Quirks>(*this, opcode);
           break;
         case 0x0002:
-          opcode_8XY2(*this, opcode);
+          opcode_8XY2<Quirks>(*this, opcode);
           break;
         case 0x0003:
-          opcode_8XY3(*this, opcode);
+          opcode_8XY3<Quirks>(*this, opcode);
           break;
         case 0x0004:
           opcode_8XY4(*this, opcode);
@@ -109,44 +311,44 @@ void CPU::process_opcode(uint16_t opcode) {
           opcode_8XY5(*this, opcode);
           break;
         case 0x0006:
-          opcode_8XY6(*this, opcode);
+          opcode_8XY6<Quirks>(*this, opcode);
           break;
         case 0x0007:
           opcode_8XY7(*this, opcode);
           break;
         case 0x000E:
-          opcode_8XYE(*this, opcode);
+          opcode_8XYE<Quirks>(*this, opcode);
           break;
         default:
-          std::cerr << "Unknown opcode [0x8000]: " << opcode << std::endl;
+          report_unknown_opcode(opcode);
           break;
       }
       break;
     case 0x9000:
-      opcode_9XY0(*this, opcode);
+      opcode_9XY0<Quirks>(*this, opcode);
       break;
     case 0xA000:
       opcode_ANNN(*this, opcode);
       break;
     case 0xB000:
-      opcode_BNNN(*this, opcode);
+      opcode_BNNN<Quirks>(*this, opcode);
       break;
     case 0xC000:
       opcode_CXNN(*this, opcode);
       break;
     case 0xD000:
-      opcode_DXYN(*this, opcode);
+      opcode_DXYN<Quirks>(*this, opcode);
       break;
     case 0xE000:
       switch (opcode & 0x00FF) {
         case 0x009E:
-          opcode_EX9E(*this, opcode);
+          opcode_EX9E<Quirks>(*this, opcode);
           break;
         case 0x00A1:
-          opcode_EXA1(*this, opcode);
+          opcode_EXA1<Quirks>(*this, opcode);
           break;
         default:
-          std::cerr << "Unknown opcode [0xE000]: " << opcode << std::endl;
+          report_unknown_opcode(opcode);
           break;
       }
       break;
@@ -174,18 +376,99 @@ void CPU::process_opcode(uint16_t opcode) {
           opcode_FX33(*this, opcode);
           break;
         case 0x0055:
-          opcode_FX55(*this, opcode);
+          opcode_FX55<Quirks>(*this, opcode);
           break;
         case 0x0065:
-          opcode_FX65(*this, opcode);
+          opcode_FX65<Quirks>(*this, opcode);
           break;
         default:
-          std::cerr << "Unknown opcode [0xF000]: " << opcode << std::endl;
+          process_extended_opcode<Quirks>(opcode);
           break;
       }
       break;
     default:
-      std::cerr << "Unknown opcode [general]: " << opcode << std::endl;
+      report_unknown_opcode(opcode);
+      break;
+  }
+}
+
+template <typename Quirks>
+void CPU::process_extended_opcode(uint16_t opcode) {
+  if (Quirks::xo_chip_instructions && process_xo_chip_opcode(opcode)) {
+    return;
+  }
+  if (Quirks::schip_instructions && process_schip_opcode(opcode)) {
+    return;
+  }
+  report_unknown_opcode(opcode);
+}
+
+bool CPU::process_schip_opcode(uint16_t opcode) {
+  if ((opcode & 0xF0F0u) == 0x00C0) {
+    opcode_00CN(*this, opcode);
+    return true;
+  }
+  switch (opcode & 0xF0FF) {
+    case 0x00FB:
+      opcode_00FB(*this);
+      return true;
+    case 0x00FC:
+      opcode_00FC(*this);
+      return true;
+    case 0x00FD:
+      opcode_00FD(*this);
+      return true;
+    case 0x00FE:
+      opcode_00FE(*this);
+      return true;
+    case 0x00FF:
+      opcode_00FF(*this);
+      return true;
+    case 0xF030:
+      opcode_FX30(*this, opcode);
+      return true;
+    case 0xF075:
+      opcode_FX75(*this, opcode);
+      return true;
+    case 0xF085:
+      opcode_FX85(*this, opcode);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool CPU::process_xo_chip_opcode(uint16_t opcode) {
+  if ((opcode & 0xF0F0u) == 0x00D0) {
+    opcode_00DN(*this, opcode);
+    return true;
+  }
+  if (opcode == 0xF000) {
+    opcode_F000(*this);
+    return true;
+  }
+  if (opcode == 0xF002) {
+    opcode_F002(*this);
+    return true;
+  }
+  switch (opcode & 0xF00F) {
+    case 0x5002:
+      opcode_5XY2(*this, opcode);
+      return true;
+    case 0x5003:
+      opcode_5XY3(*this, opcode);
+      return true;
+    default:
       break;
   }
+  switch (opcode & 0xF0FF) {
+    case 0xF001:
+      opcode_FN01(*this, opcode);
+      return true;
+    case 0xF03A:
+      opcode_FX3A(*this, opcode);
+      return true;
+    default:
+      return false;
+  }
 }
@@ -0,0 +1,296 @@
+#include "analysis.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+#include "disassembler.h"
+#include "opcode_family.h"
+
+ProgramAnalysis::ProgramAnalysis(const Memory::Data& memory, uint16_t origin,
+                                 size_t size)
+    : memory(memory),
+      origin(origin & Memory::ADDRESS_MASK),
+      end(uint32_t(std::min(this->origin + size, size_t(Memory::SIZE)))) {
+  trace(this->origin);
+  build_blocks();
+}
+
+uint16_t ProgramAnalysis::fetch(uint16_t address) const {
+  return memory[address & Memory::ADDRESS_MASK] << 8 |
+         memory[(address + 1) & Memory::ADDRESS_MASK];
+}
+
+uint16_t ProgramAnalysis::instruction_size(uint16_t address) const {
+  return opcode_family(fetch(address)) == OP_F000 ? 4 : 2;
+}
+
+std::string ProgramAnalysis::instruction_text(uint16_t address) const {
+  uint16_t opcode = fetch(address);
+  if (opcode_family(opcode) == OP_F000) {
+    char text[24];
+    std::snprintf(text, sizeof(text), "LD I, 0x%04X", fetch(address + 2));
+    return text;
+  }
+  return disassemble(opcode);
+}
+
+bool ProgramAnalysis::in_program(uint16_t address) const {
+  return address >= origin && uint32_t(address) + 1 < end;
+}
+
+// recursive traversal: every path is followed in a straight line until it
+// leaves the program, reaches code seen before or can't go on
+void ProgramAnalysis::trace(uint16_t entry) {
+  std::vector<uint16_t> pending;
+  auto follow = [&](uint16_t target) {
+    if (!in_program(target)) {
+      external_targets.insert(target);
+      return;
+    }
+    leaders.insert(target);
+    targets.insert(target);
+    pending.push_back(target);
+  };
+
+  if (!in_program(entry)) {
+    return;
+  }
+  follow(entry);
+
+  while (!pending.empty()) {
+    uint16_t address = pending.back();
+    pending.pop_back();
+
+    while (in_program(address)) {
+      if (instructions.test(address)) {
+        // joined a path traced before
+        leaders.insert(address);
+        break;
+      }
+      uint16_t opcode = fetch(address);
+      uint16_t next = address + instruction_size(address);
+      instructions.set(address);
+      for (uint16_t byte = address; byte != next && byte < end; ++byte) {
+        code.set(byte);
+      }
+
+      bool stop = false;
+      switch (opcode_family(opcode)) {
+        case OP_00EE:
+        case OP_00FD:
+        case OP_BNNN:
+          stop = true;
+          break;
+        case OP_1NNN:
+          follow(opcode & 0x0FFFu);
+          stop = true;
+          break;
+        case OP_2NNN:
+          if (in_program(opcode & 0x0FFFu)) {
+            subroutines.insert(opcode & 0x0FFFu);
+          }
+          follow(opcode & 0x0FFFu);
+          leaders.insert(next);
+          break;
+        case OP_3XNN:
+        case OP_4XNN:
+        case OP_5XY0:
+        case OP_9XY0:
+        case OP_EX9E:
+        case OP_EXA1:
+          follow(next + instruction_size(next));
+          leaders.insert(next);
+          break;
+        case OP_ANNN:
+          data_references.insert(opcode & 0x0FFFu);
+          break;
+        case OP_F000:
+          data_references.insert(fetch(address + 2));
+          break;
+        default:
+          break;
+      }
+      if (stop) {
+        break;
+      }
+      address = next;
+    }
+  }
+}
+
+void ProgramAnalysis::build_blocks() {
+  for (uint16_t leader : leaders) {
+    if (!instructions.test(leader)) {
+      continue;  // a call's return site off the end of the program
+    }
+
+    BasicBlock block;
+    block.start = leader;
+    uint16_t address = leader;
+    while (true) {
+      uint16_t opcode = fetch(address);
+      uint16_t next = address + instruction_size(address);
+      block.end = uint32_t(address) + instruction_size(address);
+
+      bool done = true;
+      switch (opcode_family(opcode)) {
+        case OP_00EE:
+          block.exit = BasicBlock::ret;
+          break;
+        case OP_BNNN:
+          block.exit = BasicBlock::indirect;
+          break;
+        case OP_00FD:
+          block.exit = BasicBlock::halt;
+          break;
+        case OP_1NNN:
+          block.exit = BasicBlock::jump;
+          block.successors.push_back(opcode & 0x0FFFu);
+          break;
+        case OP_2NNN:
+          block.exit = BasicBlock::call;
+          block.successors.push_back(opcode & 0x0FFFu);
+          block.successors.push_back(next);
+          break;
+        case OP_3XNN:
+        case OP_4XNN:
+        case OP_5XY0:
+        case OP_9XY0:
+        case OP_EX9E:
+        case OP_EXA1:
+          block.exit = BasicBlock::skip;
+          block.successors.push_back(next);
+          block.successors.push_back(next + instruction_size(next));
+          break;
+        default:
+          if (!in_program(next) || !instructions.test(next)) {
+            block.exit = BasicBlock::off_end;
+          } else if (leaders.count(next)) {
+            block.exit = BasicBlock::fall_through;
+            block.successors.push_back(next);
+          } else {
+            done = false;
+          }
+          break;
+      }
+      if (done) {
+        break;
+      }
+      address = next;
+    }
+    blocks.emplace(block.start, std::move(block));
+  }
+}
+
+void ProgramAnalysis::write_label(std::ostream& out, uint16_t address) const {
+  char label[16];
+  std::snprintf(label, sizeof(label), "%s_%03x",
+                subroutines.count(address) ? "sub" : "loc", address);
+  out << label;
+}
+
+void ProgramAnalysis::write_listing(std::ostream& out) const {
+  size_t size = end - origin;
+  out << "; " << size << " bytes, " << get_code_size() << " of code in "
+      << blocks.size() << " blocks, " << subroutines.size()
+      << " subroutines\n";
+  for (uint16_t target : external_targets) {
+    char line[48];
+    std::snprintf(line, sizeof(line), "; control flow leaves at 0x%03X\n",
+                  target);
+    out << line;
+  }
+
+  char line[64];
+  uint32_t address = origin;
+  while (address < end) {
+    if (instructions.test(address)) {
+      if (targets.count(address)) {
+        out << "\n";
+        write_label(out, address);
+        out << ":\n";
+      }
+      uint16_t opcode = fetch(address);
+      std::snprintf(line, sizeof(line), "  %03X  %04X  %s\n", address, opcode,
+                    instruction_text(address).c_str());
+      out << line;
+      // instructions can overlap when a jump lands on an odd address
+      address += instructions.test(address + 1) ? 1 : 2;
+      continue;
+    }
+    if (code.test(address)) {
+      ++address;
+      continue;
+    }
+
+    // data, up to 8 bytes a line, split at references and at code
+    if (data_references.count(address) || address == origin ||
+        code.test(address - 1)) {
+      std::snprintf(line, sizeof(line), "\ndata_%03x:\n", address);
+      out << line;
+    }
+    std::snprintf(line, sizeof(line), "  %03X        DB", address);
+    out << line;
+    int count = 0;
+    do {
+      std::snprintf(line, sizeof(line), "%s 0x%02X", count ? "," : "",
+                    memory[address]);
+      out << line;
+      ++address;
+      ++count;
+    } while (count < 8 && address < end && !code.test(address) &&
+             !data_references.count(address));
+    out << "\n";
+  }
+}
+
+void ProgramAnalysis::write_graphviz(std::ostream& out) const {
+  out << "digraph program {\n"
+      << "  node [shape=box, fontname=\"monospace\"];\n";
+
+  char line[128];
+  for (const auto& entry : blocks) {
+    const BasicBlock& block = entry.second;
+    std::snprintf(line, sizeof(line), "  b%03x [label=\"", block.start);
+    out << line;
+    write_label(out, block.start);
+    out << ":\\l";
+    for (uint32_t address = block.start; address < block.end;
+         address += instruction_size(address)) {
+      std::snprintf(line, sizeof(line), "%03X  %s\\l", address,
+                    instruction_text(address).c_str());
+      out << line;
+    }
+    out << "\"];\n";
+
+    for (size_t i = 0; i < block.successors.size(); ++i) {
+      const char* label = "";
+      if (block.exit == BasicBlock::call) {
+        label = i == 0 ? " [label=\"call\", style=bold]"
+                       : " [label=\"return\", style=dashed]";
+      } else if (block.exit == BasicBlock::skip) {
+        label = i == 0 ? "" : " [label=\"skip\"]";
+      }
+      std::snprintf(line, sizeof(line), "  b%03x -> b%03x%s;\n", block.start,
+                    block.successors[i], label);
+      out << line;
+    }
+    if (block.exit == BasicBlock::indirect) {
+      std::snprintf(line, sizeof(line),
+                    "  b%03x -> indirect_%03x [style=dotted];\n"
+                    "  indirect_%03x [label=\"V0 + 0x%03X\", shape=plaintext];\n",
+                    block.start, block.start, block.start,
+                    fetch(block.end - 2) & 0x0FFFu);
+      out << line;
+    }
+  }
+
+  for (uint16_t target : external_targets) {
+    std::snprintf(line, sizeof(line),
+                  "  b%03x [label=\"0x%03X (outside)\", shape=plaintext];\n",
+                  target, target);
+    out << line;
+  }
+  out << "}\n";
+}
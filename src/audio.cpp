@@ -0,0 +1,130 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "CPU.h"
+
+AudioSynth::AudioSynth(int sample_rate)
+    : sample_rate(sample_rate), sample_remainder(0), phase(0.0) {
+  buffer.reserve(sample_rate / 60 + 1);
+}
+
+void AudioSynth::render_frame(CPU& cpu, AudioSink& sink) {
+  int samples = (sample_rate + sample_remainder) / 60;
+  sample_remainder = (sample_rate + sample_remainder) % 60;
+  buffer.assign(samples, 0);
+
+  if (cpu.is_sound_playing()) {
+    const uint8_t* pattern = cpu.get_audio_pattern();
+    bool has_pattern =
+        std::any_of(pattern, pattern + 16, [](uint8_t b) { return b != 0; });
+
+    if (has_pattern) {
+      // 128 one-bit samples looped at 4000 * 2^((pitch - 64) / 48) Hz
+      double step =
+          4000.0 * std::exp2((cpu.get_pitch() - 64) / 48.0) / sample_rate;
+      for (int16_t& sample : buffer) {
+        int bit = int(phase);
+        sample = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1u ? AMPLITUDE
+                                                             : -AMPLITUDE;
+        phase += step;
+        if (phase >= 128.0) {
+          phase -= 128.0;
+        }
+      }
+    } else {
+      double step = double(BEEP_FREQUENCY) / sample_rate;
+      for (int16_t& sample : buffer) {
+        sample = phase < 0.5 ? AMPLITUDE : -AMPLITUDE;
+        phase += step;
+        if (phase >= 1.0) {
+          phase -= 1.0;
+        }
+      }
+    }
+  } else {
+    phase = 0.0;
+  }
+
+  sink.write(buffer.data(), buffer.size());
+}
+
+SdlAudio::SdlAudio(int sample_rate, int buffer_samples)
+    : sample_rate(sample_rate), buffer_samples(buffer_samples) {
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    std::cerr << "SDL audio could not initialize! SDL_Error: "
+              << SDL_GetError() << std::endl;
+    max_queued = 0;
+    return;
+  }
+
+  SDL_AudioSpec wanted = {};
+  wanted.freq = sample_rate;
+  wanted.format = AUDIO_S16SYS;
+  wanted.channels = 1;
+  wanted.samples = Uint16(buffer_samples);
+  wanted.callback = &SdlAudio::callback;
+  wanted.userdata = this;
+
+  SDL_AudioSpec obtained;
+  device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+  if (!device) {
+    std::cerr << "Audio device could not be opened! SDL_Error: "
+              << SDL_GetError() << std::endl;
+  } else {
+    this->buffer_samples = obtained.samples;
+  }
+
+  // a device buffer plus two frames absorbs the jitter of the frame loop
+  max_queued = std::min(size_t(this->buffer_samples + 2 * sample_rate / 60),
+                        size_t(RING_CAPACITY));
+  if (device) {
+    SDL_PauseAudioDevice(device, 0);
+  }
+}
+
+SdlAudio::~SdlAudio() {
+  if (device) {
+    SDL_CloseAudioDevice(device);
+  }
+  SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+void SdlAudio::write(const int16_t* samples, size_t count) {
+  if (!device) {
+    return;
+  }
+  if (ring.size() > max_queued) {
+    dropped += count;
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (!ring.push(samples[i])) {
+      dropped += count - i;
+      return;
+    }
+  }
+}
+
+uint64_t SdlAudio::get_latency_ns() const {
+  return (ring.size() + size_t(buffer_samples)) * 1000000000ull /
+         uint64_t(sample_rate);
+}
+
+// runs on SDL's audio thread
+void SdlAudio::callback(void* self, Uint8* stream, int length) {
+  SdlAudio& audio = *static_cast<SdlAudio*>(self);
+  int16_t* out = reinterpret_cast<int16_t*>(stream);
+  int count = length / int(sizeof(int16_t));
+
+  int i = 0;
+  while (i < count && audio.ring.pop(out[i])) {
+    ++i;
+  }
+  if (i < count) {
+    std::fill(out + i, out + count, int16_t(0));
+    audio.underruns.fetch_add(1, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,127 @@
+#include "calibration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "CPU.h"
+
+namespace {
+
+// longest loop, in instructions, that still counts as polling the timer
+const uint64_t MAX_POLL_LOOP = 8;
+
+// fraction of the instructions spent in delay timer polling loops: an FX07
+// that reads a running timer and is executed again from the same address a
+// few instructions later closes one iteration of such a loop
+// time the program is stopped isn't play and isn't counted: FX0A waiting for
+// a key, and the jump to itself programs end with
+double measure_wait(const Snapshot& root, QuirkProfile quirks,
+                    int instructions_per_frame, int frames) {
+  Memory memory;
+  Display display(true);
+  Input input;
+  CPU cpu(memory, display, input);
+  cpu.set_quirks(quirks);
+  cpu.load_snapshot(root);
+
+  const Memory::Data& data = memory.get_data();
+  uint64_t executed = 0;
+  uint64_t waiting = 0;
+  uint64_t stopped = 0;
+  uint16_t poll_pc = 0;
+  uint64_t poll_at = 0;
+  bool polled = false;
+
+  for (int frame = 0; frame < frames; ++frame) {
+    input.set_keys((frame / 30) % 3 == 0 ? 1u << ((frame / 90) % 16) : 0);
+    for (int i = 0; i < instructions_per_frame; ++i, ++executed) {
+      uint16_t pc = cpu.get_pc();
+      uint8_t high = data[pc & Memory::ADDRESS_MASK];
+      uint8_t low = data[(pc + 1) & Memory::ADDRESS_MASK];
+      if (((high & 0xF0) == 0xF0 && low == 0x0A) ||
+          uint16_t((high << 8 | low) ^ 0x1000) == pc) {
+        cpu.step();
+        stopped += cpu.get_pc() == pc;
+        continue;
+      }
+      if ((high & 0xF0) == 0xF0 && low == 0x07 && cpu.get_delay_timer() > 0) {
+        if (polled && pc == poll_pc && executed - poll_at <= MAX_POLL_LOOP) {
+          waiting += executed - poll_at;
+        }
+        poll_pc = pc;
+        poll_at = executed;
+        polled = true;
+      }
+      cpu.step();
+    }
+    cpu.end_frame();
+  }
+  uint64_t played = executed - stopped;
+  return played ? double(waiting) / played : 0.0;
+}
+
+}  // namespace
+
+CalibrationResult calibrate(const Snapshot& root,
+                            const CalibrationOptions& options) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  CalibrationResult result;
+  for (int candidate : options.candidates) {
+    result.measurements.push_back({candidate, 0.0});
+  }
+
+  unsigned thread_count = options.threads;
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::min<unsigned>(thread_count,
+                                    unsigned(result.measurements.size()));
+
+  // every worker takes the next setting and plays it on its own machine
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < result.measurements.size(); i = next++) {
+      SpeedMeasurement& measurement = result.measurements[i];
+      measurement.wait_fraction =
+          measure_wait(root, options.quirks,
+                       measurement.instructions_per_frame, options.frames);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  // the lowest setting with enough spare time, or the fastest one tried if
+  // the program is still CPU-bound there
+  std::vector<SpeedMeasurement> by_speed = result.measurements;
+  std::sort(by_speed.begin(), by_speed.end(),
+            [](const SpeedMeasurement& a, const SpeedMeasurement& b) {
+              return a.instructions_per_frame < b.instructions_per_frame;
+            });
+  result.instructions_per_frame = options.fallback;
+  for (const SpeedMeasurement& measurement : by_speed) {
+    result.paced = result.paced || measurement.wait_fraction > 0.0;
+  }
+  if (result.paced) {
+    result.instructions_per_frame = by_speed.back().instructions_per_frame;
+    for (const SpeedMeasurement& measurement : by_speed) {
+      if (measurement.wait_fraction >= options.min_wait) {
+        result.instructions_per_frame = measurement.instructions_per_frame;
+        break;
+      }
+    }
+  }
+
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+  return result;
+}
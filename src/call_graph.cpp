@@ -0,0 +1,56 @@
+#include "call_graph.h"
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+CallGraphProfiler::CallGraphProfiler() { reset(); }
+
+void CallGraphProfiler::reset() {
+  // node 0 is the program entry at 0x200
+  nodes.assign(1, {0, 0x200, 0, 0});
+  children.clear();
+  current = 0;
+  overflow = 0;
+}
+
+void CallGraphProfiler::call(uint16_t entry) {
+  if (nodes[current].depth >= MAX_DEPTH) {
+    ++overflow;
+    return;
+  }
+
+  uint64_t key = uint64_t(current) << 16u | entry;
+  auto child = children.find(key);
+  if (child == children.end()) {
+    nodes.push_back({current, entry, nodes[current].depth + 1, 0});
+    child = children.emplace(key, uint32_t(nodes.size() - 1)).first;
+  }
+  current = child->second;
+}
+
+void CallGraphProfiler::ret() {
+  if (overflow > 0) {
+    --overflow;
+  } else {
+    // a return at the top level (unbalanced stack) stays at the root
+    current = nodes[current].parent;
+  }
+}
+
+void CallGraphProfiler::write_collapsed(std::ostream& out) const {
+  char label[16];
+  for (uint32_t index = 0; index < nodes.size(); ++index) {
+    if (nodes[index].instructions == 0) {
+      continue;
+    }
+
+    std::string path;
+    for (uint32_t n = index; n != 0; n = nodes[n].parent) {
+      std::snprintf(label, sizeof(label), ";sub_%03x", nodes[n].entry);
+      path.insert(0, label);
+    }
+    out << "main" << path << ' ' << nodes[index].instructions << '\n';
+  }
+  out.flush();
+}
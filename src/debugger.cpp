@@ -0,0 +1,53 @@
+#include "debugger.h"
+
+bool BreakCondition::holds(const uint8_t* V) const {
+  uint8_t current = V[reg & 0xFu];
+  switch (compare) {
+    case eq:
+      return current == value;
+    case ne:
+      return current != value;
+    case lt:
+      return current < value;
+    case gt:
+      return current > value;
+  }
+  return false;
+}
+
+void Debugger::add_breakpoint(uint16_t pc) {
+  pc &= Memory::ADDRESS_MASK;
+  breakpoints.set(pc);
+  conditions.erase(pc);
+}
+
+void Debugger::add_breakpoint(uint16_t pc, BreakCondition condition) {
+  pc &= Memory::ADDRESS_MASK;
+  breakpoints.set(pc);
+  conditions[pc].push_back(condition);
+}
+
+void Debugger::remove_breakpoint(uint16_t pc) {
+  pc &= Memory::ADDRESS_MASK;
+  breakpoints.reset(pc);
+  conditions.erase(pc);
+}
+
+void Debugger::add_watchpoint(uint16_t address, bool on_read, bool on_write) {
+  address &= Memory::ADDRESS_MASK;
+  read_watches.set(address, on_read);
+  write_watches.set(address, on_write);
+}
+
+void Debugger::remove_watchpoint(uint16_t address) {
+  add_watchpoint(address, false, false);
+}
+
+void Debugger::clear() {
+  breakpoints.reset();
+  read_watches.reset();
+  write_watches.reset();
+  conditions.clear();
+  stopped_pc = -1;
+  watch_hit = false;
+}
@@ -0,0 +1,94 @@
+#include "diagnostics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <vector>
+
+namespace {
+
+const char* kind_name(AnomalyKind kind) {
+  switch (kind) {
+    case AnomalyKind::unknown_opcode:
+      return "unknown opcode";
+  }
+  return "anomaly";
+}
+
+}  // namespace
+
+Diagnostics::Diagnostics(std::ostream& out, std::chrono::milliseconds interval)
+    : out(out), interval(interval), logger(&Diagnostics::run, this) {}
+
+Diagnostics::~Diagnostics() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  logger.join();
+}
+
+void Diagnostics::run() {
+  // the queue is drained several times per interval so it rarely fills up
+  auto drain_period = std::max(interval / 10, std::chrono::milliseconds(1));
+  auto next_summary = std::chrono::steady_clock::now() + interval;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    wake.wait_for(lock, drain_period);
+    drain();
+    if (std::chrono::steady_clock::now() >= next_summary) {
+      print_summary(interval_counts, "anomalies in the last interval");
+      interval_counts.clear();
+      next_summary = std::chrono::steady_clock::now() + interval;
+    }
+  }
+
+  drain();
+  print_summary(total_counts, "anomalies in this session");
+}
+
+void Diagnostics::drain() {
+  Event event;
+  while (queue.pop(event)) {
+    Site site{event.kind, event.pc, event.opcode};
+    interval_counts[site] += event.count;
+    total_counts[site] += event.count;
+  }
+}
+
+void Diagnostics::print_summary(const std::map<Site, uint64_t>& counts,
+                                const char* title) {
+  if (counts.empty()) {
+    return;
+  }
+
+  std::vector<std::pair<Site, uint64_t>> sites(counts.begin(), counts.end());
+  std::sort(sites.begin(), sites.end(),
+            [](const auto& a, const auto& b) { return a.second > b.second; });
+
+  uint64_t total = 0;
+  for (const auto& site : sites) {
+    total += site.second;
+  }
+
+  char line[96];
+  out << title << ": " << total << "\n";
+  for (size_t i = 0; i < sites.size() && i < MAX_SUMMARY_LINES; ++i) {
+    std::snprintf(line, sizeof(line), "  %s 0x%04X at 0x%03X: %llu\n",
+                  kind_name(std::get<0>(sites[i].first)),
+                  std::get<2>(sites[i].first), std::get<1>(sites[i].first),
+                  static_cast<unsigned long long>(sites[i].second));
+    out << line;
+  }
+  if (sites.size() > MAX_SUMMARY_LINES) {
+    out << "  ... and " << sites.size() - MAX_SUMMARY_LINES << " more sites\n";
+  }
+  uint64_t lost = get_dropped();
+  if (lost) {
+    out << "  (" << lost << " reports dropped, queue full)\n";
+  }
+  out.flush();
+}
@@ -0,0 +1,162 @@
+#include "disassembler.h"
+
+#include <cstdio>
+
+#include "opcode_family.h"
+
+std::string disassemble(uint16_t opcode) {
+  unsigned x = (opcode & 0x0F00u) >> 8u;
+  unsigned y = (opcode & 0x00F0u) >> 4u;
+  unsigned n = opcode & 0x000Fu;
+  unsigned nn = opcode & 0x00FFu;
+  unsigned nnn = opcode & 0x0FFFu;
+
+  char text[32];
+  switch (opcode_family(opcode)) {
+    case OP_00E0:
+      return "CLS";
+    case OP_00EE:
+      return "RET";
+    case OP_00CN:
+      std::snprintf(text, sizeof(text), "SCD %u", n);
+      break;
+    case OP_00DN:
+      std::snprintf(text, sizeof(text), "SCU %u", n);
+      break;
+    case OP_00FB:
+      return "SCR";
+    case OP_00FC:
+      return "SCL";
+    case OP_00FD:
+      return "EXIT";
+    case OP_00FE:
+      return "LOW";
+    case OP_00FF:
+      return "HIGH";
+    case OP_1NNN:
+      std::snprintf(text, sizeof(text), "JP 0x%03X", nnn);
+      break;
+    case OP_2NNN:
+      std::snprintf(text, sizeof(text), "CALL 0x%03X", nnn);
+      break;
+    case OP_3XNN:
+      std::snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, nn);
+      break;
+    case OP_4XNN:
+      std::snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, nn);
+      break;
+    case OP_5XY0:
+      std::snprintf(text, sizeof(text), "SE V%X, V%X", x, y);
+      break;
+    case OP_5XY2:
+      std::snprintf(text, sizeof(text), "LD [I], V%X-V%X", x, y);
+      break;
+    case OP_5XY3:
+      std::snprintf(text, sizeof(text), "LD V%X-V%X, [I]", x, y);
+      break;
+    case OP_6XNN:
+      std::snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, nn);
+      break;
+    case OP_7XNN:
+      std::snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, nn);
+      break;
+    case OP_8XY0:
+      std::snprintf(text, sizeof(text), "LD V%X, V%X", x, y);
+      break;
+    case OP_8XY1:
+      std::snprintf(text, sizeof(text), "OR V%X, V%X", x, y);
+      break;
+    case OP_8XY2:
+      std::snprintf(text, sizeof(text), "AND V%X, V%X", x, y);
+      break;
+    case OP_8XY3:
+      std::snprintf(text, sizeof(text), "XOR V%X, V%X", x, y);
+      break;
+    case OP_8XY4:
+      std::snprintf(text, sizeof(text), "ADD V%X, V%X", x, y);
+      break;
+    case OP_8XY5:
+      std::snprintf(text, sizeof(text), "SUB V%X, V%X", x, y);
+      break;
+    case OP_8XY6:
+      std::snprintf(text, sizeof(text), "SHR V%X", x);
+      break;
+    case OP_8XY7:
+      std::snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y);
+      break;
+    case OP_8XYE:
+      std::snprintf(text, sizeof(text), "SHL V%X", x);
+      break;
+    case OP_9XY0:
+      std::snprintf(text, sizeof(text), "SNE V%X, V%X", x, y);
+      break;
+    case OP_ANNN:
+      std::snprintf(text, sizeof(text), "LD I, 0x%03X", nnn);
+      break;
+    case OP_BNNN:
+      std::snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn);
+      break;
+    case OP_CXNN:
+      std::snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, nn);
+      break;
+    case OP_DXYN:
+      std::snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n);
+      break;
+    case OP_EX9E:
+      std::snprintf(text, sizeof(text), "SKP V%X", x);
+      break;
+    case OP_EXA1:
+      std::snprintf(text, sizeof(text), "SKNP V%X", x);
+      break;
+    case OP_F000:
+      return "LD I, LONG";  // the address is the next word
+    case OP_FN01:
+      std::snprintf(text, sizeof(text), "PLANE %u", x);
+      break;
+    case OP_F002:
+      return "AUDIO";
+    case OP_FX07:
+      std::snprintf(text, sizeof(text), "LD V%X, DT", x);
+      break;
+    case OP_FX0A:
+      std::snprintf(text, sizeof(text), "LD V%X, K", x);
+      break;
+    case OP_FX15:
+      std::snprintf(text, sizeof(text), "LD DT, V%X", x);
+      break;
+    case OP_FX18:
+      std::snprintf(text, sizeof(text), "LD ST, V%X", x);
+      break;
+    case OP_FX1E:
+      std::snprintf(text, sizeof(text), "ADD I, V%X", x);
+      break;
+    case OP_FX29:
+      std::snprintf(text, sizeof(text), "LD F, V%X", x);
+      break;
+    case OP_FX30:
+      std::snprintf(text, sizeof(text), "LD HF, V%X", x);
+      break;
+    case OP_FX33:
+      std::snprintf(text, sizeof(text), "LD B, V%X", x);
+      break;
+    case OP_FX3A:
+      std::snprintf(text, sizeof(text), "PITCH V%X", x);
+      break;
+    case OP_FX55:
+      std::snprintf(text, sizeof(text), "LD [I], V%X", x);
+      break;
+    case OP_FX65:
+      std::snprintf(text, sizeof(text), "LD V%X, [I]", x);
+      break;
+    case OP_FX75:
+      std::snprintf(text, sizeof(text), "LD R, V%X", x);
+      break;
+    case OP_FX85:
+      std::snprintf(text, sizeof(text), "LD V%X, R", x);
+      break;
+    default:
+      std::snprintf(text, sizeof(text), "DW 0x%04X", opcode);
+      break;
+  }
+  return text;
+}
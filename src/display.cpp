@@ -2,12 +2,81 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <cstring>
+
 #include "SDL.h"
+#include "fonts.h"
 #include "SDL_render.h"
 #include "SDL_video.h"
 #include "iostream"
+#include "timeline.h"
+
+namespace {
+
+// ARGB pixels for every value of a framebuffer byte, at native and at double
+// width, so expand() copies 8 pixels at a time
+struct ExpandTables {
+  uint32_t single[256][8];
+  uint32_t doubled[256][16];
+
+  ExpandTables() {
+    for (int value = 0; value < 256; ++value) {
+      for (int bit = 0; bit < 8; ++bit) {
+        uint32_t color = (value & (0x80 >> bit)) ? Display::ON_COLOR
+                                                 : Display::OFF_COLOR;
+        single[value][bit] = color;
+        doubled[value][2 * bit] = color;
+        doubled[value][2 * bit + 1] = color;
+      }
+    }
+  }
+};
+
+const ExpandTables& expand_tables() {
+  static const ExpandTables tables;
+  return tables;
+}
+
+inline int lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(bits);
+#else
+  int bit = 0;
+  while (!(bits & 1u)) {
+    bits >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+// recolors the pixels lit in the second plane over 8 framebuffer pixels
+// already expanded from the first one, each covering scale output pixels
+inline void blend_second_plane(uint32_t* out, uint8_t first, uint8_t second,
+                               int scale) {
+  for (uint64_t lit = second; lit; lit &= lit - 1) {
+    int bit = lowest_bit(lit);
+    uint32_t color =
+        (first >> bit) & 1u ? Display::BLEND_COLOR : Display::PLANE2_COLOR;
+    std::fill_n(out + scale * (7 - bit), scale, color);
+  }
+}
+
+}  // namespace
+
+Display::Display(bool headless)
+    : screen{},
+      hires(false),
+      planes(1),
+      window(nullptr),
+      renderer(nullptr),
+      texture(nullptr) {
+  if (headless) {
+    clear();
+    return;
+  }
 
-Display::Display() {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError()
               << std::endl;
@@ -16,7 +85,8 @@ Display::Display() {
 
   window =
       SDL_CreateWindow("c8emu", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                       WIDTH * SCALE, HEIGHT * SCALE, SDL_WINDOW_SHOWN);
+                       LORES_WIDTH * SCALE, LORES_HEIGHT * SCALE,
+                       SDL_WINDOW_SHOWN);
   if (!window) {
     std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError()
               << std::endl;
@@ -30,58 +100,305 @@ Display::Display() {
     exit(1);
   }
 
+  // the framebuffer is uploaded at the high resolution and scaled by the GPU
+  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                              SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+  if (!texture) {
+    std::cerr << "Texture could not be created! SDL_Error: " << SDL_GetError()
+              << std::endl;
+    exit(1);
+  }
+
   clear();
 }
 
 Display::~Display() {
+  if (!window) {
+    return;
+  }
+  SDL_DestroyTexture(texture);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
   SDL_Quit();
 }
 
 void Display::clear() {
-  for (auto& row : screen) {
-    row.fill(false);
+  for (int plane = 0; plane < PLANES; ++plane) {
+    if (planes & (1u << plane)) {
+      screen[plane].fill(Row{0, 0});
+    }
+  }
+  rehash();
+  if (!renderer) {
+    return;
   }
   SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
   SDL_RenderClear(renderer);
   SDL_RenderPresent(renderer);
 }
 
+void Display::set_hires(bool new_hires) {
+  hires = new_hires;
+  for (Plane& plane : screen) {
+    plane.fill(Row{0, 0});
+  }
+  hash = 0;
+}
+
+void Display::set_planes(uint8_t mask) { planes = mask & ((1u << PLANES) - 1); }
+
+// turns one row of up to 16 sprite pixels into a mask over a screen row;
+// bits holds them left-aligned (pixel x in the top bit) and is shifted into
+// place across the two words of the row
+template <bool Wrap>
+Display::Row Display::row_mask(int x, uint64_t bits) const {
+  Row mask = {0, 0};
+  if (!hires) {
+    mask[0] = bits >> x;
+    if (Wrap && x > 0) {
+      mask[0] |= bits << (64 - x);
+    }
+  } else if (x < 64) {
+    mask[0] = bits >> x;
+    mask[1] = x > 0 ? bits << (64 - x) : 0;
+  } else {
+    mask[1] = bits >> (x - 64);
+    if (Wrap && x > 64) {
+      mask[0] = bits << (128 - x);
+    }
+  }
+  return mask;
+}
+
+// xors a row mask into one plane, two words at once
+bool Display::draw_row(int plane, int y, const Row& mask) {
+  Row& row = screen[plane][y];
+  bool collision = (row[0] & mask[0]) | (row[1] & mask[1]);
+  row[0] ^= mask[0];
+  row[1] ^= mask[1];
+
+  // every flipped pixel toggles its key
+  for (int word = 0; word < 2; ++word) {
+    for (uint64_t flipped = mask[word]; flipped; flipped &= flipped - 1) {
+      hash ^= pixel_key(word * 64 + 63 - lowest_bit(flipped), y, plane);
+    }
+  }
+  return collision;
+}
+
+// the selected planes are drawn row by row side by side, each from its own
+// part of the sprite data
+template <bool Wrap>
 bool Display::draw_sprite(uint8_t x, uint8_t y, const uint8_t* sprite,
                           uint8_t n) {
+  int width = get_width();
+  int height = get_height();
   bool collision = false;
 
-  for (uint8_t row = 0; row < n; ++row) {
-    uint8_t sprite_byte = sprite[row];
-    for (uint8_t col = 0; col < 8; ++col) {
-      if ((sprite_byte & (0x80 >> col)) != 0) {
-        uint8_t screen_x = (x + col) % WIDTH;
-        uint8_t screen_y = (y + row) % HEIGHT;
-        if (screen[screen_y][screen_x]) {
-          collision = true;
-        }
-        screen[screen_y][screen_x] ^= true;
+  for (int row = 0; row < n; ++row) {
+    int screen_y = y % height + row;
+    if (!Wrap && screen_y >= height) {
+      break;
+    }
+    const uint8_t* bytes = sprite + row;
+    for (int plane = 0; plane < PLANES; ++plane) {
+      if (planes & (1u << plane)) {
+        Row mask = row_mask<Wrap>(x % width, uint64_t(*bytes) << 56u);
+        collision |= draw_row(plane, screen_y % height, mask);
+        bytes += n;
       }
     }
   }
   return collision;
 }
 
-void Display::render() {
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-  SDL_RenderClear(renderer);
+template <bool Wrap>
+bool Display::draw_sprite16(uint8_t x, uint8_t y, const uint8_t* sprite) {
+  int width = get_width();
+  int height = get_height();
+  bool collision = false;
+
+  for (int row = 0; row < 16; ++row) {
+    int screen_y = y % height + row;
+    if (!Wrap && screen_y >= height) {
+      break;
+    }
+    const uint8_t* bytes = sprite + 2 * row;
+    for (int plane = 0; plane < PLANES; ++plane) {
+      if (planes & (1u << plane)) {
+        uint64_t bits = uint64_t(bytes[0]) << 56u | uint64_t(bytes[1]) << 48u;
+        collision |=
+            draw_row(plane, screen_y % height, row_mask<Wrap>(x % width, bits));
+        bytes += 32;
+      }
+    }
+  }
+  return collision;
+}
+
+template bool Display::draw_sprite<true>(uint8_t, uint8_t, const uint8_t*,
+                                         uint8_t);
+template bool Display::draw_sprite<false>(uint8_t, uint8_t, const uint8_t*,
+                                          uint8_t);
+template bool Display::draw_sprite16<true>(uint8_t, uint8_t, const uint8_t*);
+template bool Display::draw_sprite16<false>(uint8_t, uint8_t, const uint8_t*);
+
+// scrolls move whole rows (vertically) or shift them as 128-bit values
+// (horizontally); the hash is rebuilt afterwards since every pixel moved
+void Display::scroll_up(int rows) {
+  int height = get_height();
+  rows = std::min(rows, height);
+  for (int plane = 0; plane < PLANES; ++plane) {
+    if (planes & (1u << plane)) {
+      Plane& lines = screen[plane];
+      std::copy(lines.begin() + rows, lines.begin() + height,
+                lines.begin());
+      std::fill(lines.begin() + height - rows, lines.begin() + height,
+                Row{0, 0});
+    }
+  }
+  rehash();
+}
+
+void Display::scroll_down(int rows) {
+  int height = get_height();
+  rows = std::min(rows, height);
+  for (int plane = 0; plane < PLANES; ++plane) {
+    if (planes & (1u << plane)) {
+      Plane& lines = screen[plane];
+      std::copy_backward(lines.begin(), lines.begin() + height - rows,
+                         lines.begin() + height);
+      std::fill(lines.begin(), lines.begin() + rows, Row{0, 0});
+    }
+  }
+  rehash();
+}
+
+void Display::scroll_right() {
+  for (int plane = 0; plane < PLANES; ++plane) {
+    if (planes & (1u << plane)) {
+      for (Row& row : screen[plane]) {
+        row[1] = hires ? (row[1] >> 4u) | (row[0] << 60u) : 0;
+        row[0] >>= 4u;
+      }
+    }
+  }
+  rehash();
+}
+
+void Display::scroll_left() {
+  for (int plane = 0; plane < PLANES; ++plane) {
+    if (planes & (1u << plane)) {
+      for (Row& row : screen[plane]) {
+        row[0] = (row[0] << 4u) | (hires ? row[1] >> 60u : 0);
+        row[1] <<= 4u;
+      }
+    }
+  }
+  rehash();
+}
+
+void Display::rehash() {
+  hash = 0;
+  for (int plane = 0; plane < PLANES; ++plane) {
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int word = 0; word < 2; ++word) {
+        for (uint64_t lit = screen[plane][y][word]; lit; lit &= lit - 1) {
+          hash ^= pixel_key(word * 64 + 63 - lowest_bit(lit), y, plane);
+        }
+      }
+    }
+  }
+}
+
+void Display::restore(const Screen& pixels, uint64_t pixels_hash,
+                      bool new_hires, uint8_t new_planes) {
+  screen = pixels;
+  hires = new_hires;
+  planes = new_planes;
+  hash = pixels_hash ^ mode_key();
+}
+
+void Display::expand(uint32_t* pixels, int stride) const {
+  const ExpandTables& tables = expand_tables();
+  const Plane& first = screen[0];
+  const Plane& second = screen[1];
+  if (hires) {
+    for (int y = 0; y < HEIGHT; ++y) {
+      uint32_t* out = pixels + y * stride;
+      for (int byte = 0; byte < WIDTH / 8; ++byte) {
+        int shift = 56 - 8 * (byte % 8);
+        uint8_t value = first[y][byte / 8] >> shift;
+        std::memcpy(out + 8 * byte, tables.single[value],
+                    sizeof(tables.single[value]));
+        if (uint8_t other = second[y][byte / 8] >> shift) {
+          blend_second_plane(out + 8 * byte, value, other, 1);
+        }
+      }
+    }
+    return;
+  }
+
+  // every low resolution pixel covers 2x2 pixels of the output
+  for (int y = 0; y < LORES_HEIGHT; ++y) {
+    uint32_t* out = pixels + 2 * y * stride;
+    for (int byte = 0; byte < LORES_WIDTH / 8; ++byte) {
+      uint8_t value = first[y][0] >> (56 - 8 * byte);
+      std::memcpy(out + 16 * byte, tables.doubled[value],
+                  sizeof(tables.doubled[value]));
+      if (uint8_t other = second[y][0] >> (56 - 8 * byte)) {
+        blend_second_plane(out + 16 * byte, value, other, 2);
+      }
+    }
+    std::memcpy(out + stride, out, WIDTH * sizeof(uint32_t));
+  }
+}
+
+void Display::set_overlay(const std::string& text) { overlay = text; }
+
+void Display::draw_overlay(uint32_t* pixels, int stride) const {
+  int x = 1;
+  for (char c : overlay) {
+    int digit = -1;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    }
 
-  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    if (digit >= 0 && x + 4 <= WIDTH) {
+      for (int row = 0; row < 5; ++row) {
+        uint8_t glyph_row = fontset[digit * 5 + row];
+        for (int col = 0; col < 4; ++col) {
+          if (glyph_row & (0x80 >> col)) {
+            pixels[(1 + row) * stride + x + col] = OVERLAY_COLOR;
+          }
+        }
+      }
+    }
+    x += 5;
+  }
+}
+
+void Display::render() {
+  if (!renderer) {
+    return;
+  }
 
-  for (int y = 0; y < HEIGHT; ++y) {
-    for (int x = 0; x < WIDTH; ++x) {
-      if (screen[y][x]) {
-        SDL_Rect rect = {x * SCALE, y * SCALE, SCALE, SCALE};
-        SDL_RenderFillRect(renderer, &rect);
+  {
+    timeline::Scope scope("render");
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+      expand(static_cast<uint32_t*>(pixels), pitch / sizeof(uint32_t));
+      if (!overlay.empty()) {
+        draw_overlay(static_cast<uint32_t*>(pixels), pitch / sizeof(uint32_t));
       }
+      SDL_UnlockTexture(texture);
     }
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
   }
 
+  timeline::Scope scope("present");
   SDL_RenderPresent(renderer);
 }
@@ -0,0 +1,194 @@
+#include "history.h"
+
+#include <algorithm>
+
+History::History(CPU& cpu, int instructions_per_frame, uint64_t interval,
+                 size_t capacity)
+    : cpu(cpu),
+      instructions_per_frame(instructions_per_frame),
+      interval(interval),
+      capacity(capacity),
+      first(0),
+      count(0),
+      next_event(0),
+      position(0) {
+  take_checkpoint();
+}
+
+uint64_t History::get_oldest_position() const {
+  return checkpoints[first].position;
+}
+
+void History::step() {
+  if (position % interval == 0 && checkpoint(count - 1).position < position) {
+    take_checkpoint();
+  }
+  execute();
+}
+
+void History::run_frame() {
+  for (int i = 0; i < instructions_per_frame; ++i) {
+    step();
+  }
+}
+
+void History::set_keys(uint16_t keys) {
+  key_events.push_back({position, keys});
+  cpu.get_input().set_keys(keys);
+
+  // restoring a checkpoint skips the events at its own position, so one
+  // taken right here has to see the change too
+  Checkpoint& newest = checkpoint(count - 1);
+  if (newest.position == position) {
+    newest.snapshot.keys = keys;
+  }
+}
+
+bool History::seek(uint64_t target) {
+  if (target > position) {
+    return false;
+  }
+  if (target == position) {
+    return true;
+  }
+  size_t offset = checkpoint_before(target);
+  if (offset == count) {
+    return false;
+  }
+
+  replay_to(offset, target);
+
+  // forget the future
+  count = offset + 1;
+  while (!key_events.empty() && key_events.back().position > target) {
+    key_events.pop_back();
+  }
+  return true;
+}
+
+bool History::step_back(uint64_t instructions) {
+  return instructions <= position && seek(position - instructions);
+}
+
+StopReason History::reverse_continue(Debugger& debugger) {
+  uint64_t end = position;
+  if (end == 0 || end <= get_oldest_position()) {
+    return StopReason::completed;
+  }
+
+  // scan the segments between checkpoints from the newest back and stop on
+  // the first one with a hit; the last hit in it is the one we want
+  uint64_t segment_end = end;
+  cpu.set_replaying(true);
+  for (size_t offset = checkpoint_before(end - 1); offset < count; --offset) {
+    restore(offset);
+    debugger.take_watch_hit();
+
+    bool found = false;
+    uint64_t found_position = 0;
+    StopReason reason = StopReason::completed;
+    while (position < segment_end) {
+      if (debugger.should_break(cpu.get_pc(), cpu.get_registers())) {
+        found = true;
+        found_position = position;
+        reason = StopReason::breakpoint;
+      }
+      replay_step();
+      if (debugger.take_watch_hit() && position < end) {
+        found = true;
+        found_position = position;
+        reason = StopReason::watchpoint;
+      }
+    }
+
+    if (found) {
+      cpu.set_replaying(false);
+      seek(found_position);
+      if (reason == StopReason::breakpoint) {
+        // arm the debugger so that running forward leaves the breakpoint
+        debugger.check_breakpoint(cpu.get_pc(), cpu.get_registers());
+      }
+      return reason;
+    }
+    segment_end = checkpoint(offset).position;
+  }
+
+  // no hit within reach, go back to where we were
+  cpu.set_replaying(false);
+  replay_to(checkpoint_before(end), end);
+  return StopReason::completed;
+}
+
+// the ring only grows up to capacity, then each new checkpoint replaces the
+// oldest one together with the key events that only it needed
+void History::take_checkpoint() {
+  if (count == checkpoints.size() && count < capacity) {
+    checkpoints.emplace_back();
+  } else if (count == checkpoints.size()) {
+    first = (first + 1) % checkpoints.size();
+    --count;
+    uint64_t oldest = checkpoint(0).position;
+    while (!key_events.empty() && key_events.front().position <= oldest) {
+      key_events.pop_front();
+    }
+  }
+
+  Checkpoint& slot = checkpoint(count);
+  slot.position = position;
+  cpu.save_snapshot(slot.snapshot);
+  ++count;
+}
+
+// returns the offset of the newest checkpoint at or before the target, or
+// count if the target is older than all of them
+// (checkpoints sit on consecutive multiples of interval, so no search needed)
+size_t History::checkpoint_before(uint64_t target) const {
+  uint64_t oldest = get_oldest_position();
+  if (target < oldest) {
+    return count;
+  }
+  return std::min<uint64_t>((target - oldest) / interval, count - 1);
+}
+
+void History::restore(size_t offset) {
+  const Checkpoint& start = checkpoint(offset);
+  cpu.load_snapshot(start.snapshot);
+  position = start.position;
+
+  // key events at the checkpoint's position are already in the snapshot
+  next_event = std::upper_bound(key_events.begin(), key_events.end(),
+                                position,
+                                [](uint64_t value, const KeyEvent& event) {
+                                  return value < event.position;
+                                }) -
+               key_events.begin();
+}
+
+// restores checkpoint offset and re-executes up to target, without the
+// instrumentation seeing those instructions a second time
+void History::replay_to(size_t offset, uint64_t target) {
+  restore(offset);
+  cpu.set_replaying(true);
+  while (position < target) {
+    replay_step();
+  }
+  cpu.set_replaying(false);
+}
+
+void History::execute() {
+  cpu.step();
+  ++position;
+  if (position % instructions_per_frame == 0) {
+    cpu.end_frame();
+  }
+}
+
+// execute() that also replays the keypad changes from the log
+void History::replay_step() {
+  execute();
+  while (next_event < key_events.size() &&
+         key_events[next_event].position == position) {
+    cpu.get_input().set_keys(key_events[next_event].keys);
+    ++next_event;
+  }
+}
@@ -6,7 +6,8 @@
 
 Input::Input() { key_state.fill(false); }
 
-void Input::handle_event(const SDL_Event& event) {
+bool Input::handle_event(const SDL_Event& event) {
+  uint16_t keys_before = get_keys();
   if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
     bool is_pressed = (event.type == SDL_KEYDOWN);
     switch (event.key.keysym.sym) {
@@ -60,6 +61,7 @@ void Input::handle_event(const SDL_Event& event) {
         break;
     }
   }
+  return get_keys() != keys_before;
 }
 
 bool Input::is_key_down(uint8_t key) const { return key_state[key]; }
@@ -72,3 +74,19 @@ bool Input::is_any_key_down() const {
   }
   return false;
 }
+
+uint16_t Input::get_keys() const {
+  uint16_t mask = 0;
+  for (size_t key = 0; key < key_state.size(); ++key) {
+    if (key_state[key]) {
+      mask |= 1u << key;
+    }
+  }
+  return mask;
+}
+
+void Input::set_keys(uint16_t mask) {
+  for (size_t key = 0; key < key_state.size(); ++key) {
+    key_state[key] = (mask >> key) & 1u;
+  }
+}
@@ -1,17 +1,556 @@
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include "CPU.h"
+#include "audio.h"
+#include "call_graph.h"
 #include "SDL.h"
 #include "SDL_events.h"
+#include "debugger.h"
+#include "diagnostics.h"
+#include "disassembler.h"
+#include "history.h"
 #include "display.h"
 #include "memory.h"
+#include "metrics.h"
+#include "movie.h"
+#include "profiler.h"
+#include "quirks.h"
+#include "rom_bundle.h"
+#include "rom_profile.h"
+#include "timeline.h"
+#include "trace.h"
+#include "vip_timing.h"
+#include "wav_writer.h"
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " <ROM file> [options]\n"
+            << "options:\n"
+            << "  --bundle FILE    take the ROM from a bundle, the ROM argument"
+            << " being its\n"
+            << "                   name or content hash (see chip8_pack)\n"
+            << "  --seed N         seed for the CXNN random number generator\n"
+            << "  --ipf N          instructions per 60 Hz frame (default: from"
+            << " the ROM\n"
+            << "                   profile, or 10)\n"
+            << "  --profiles FILE  ROM profiles written by chip8_calibrate"
+            << " (default:\n"
+            << "                   " << RomProfiles::DEFAULT_FILE << ")\n"
+            << "  --vip-timing     run instructions at their COSMAC VIP speed"
+            << " instead of\n"
+            << "                   a fixed number per frame\n"
+            << "  --quirks P       quirk profile: vip, chip48, schip or xochip"
+            << " (default:\n"
+            << "                   detected from the ROM)\n"
+            << "  --record FILE    record the keypad input to a movie file\n"
+            << "  --replay FILE    replay a movie headless at maximum speed\n"
+            << "  --profile        print an opcode profile at exit (F2 prints"
+            << " it on demand;\n"
+            << "                   needs a build with -DC8EMU_PROFILE=ON)\n"
+            << "  --flamegraph FILE  write guest call stacks in collapsed"
+            << " format at exit\n"
+            << "                   (also needs -DC8EMU_PROFILE=ON)\n"
+            << "  --trace FILE     keep an execution trace, written to FILE at"
+            << " exit, on F3\n"
+            << "                   and to FILE.anomaly on the first unknown"
+            << " opcode\n"
+            << "  --timeline FILE  write a Chrome trace of the host frame"
+            << " timeline at exit\n"
+            << "  --metrics FILE   write live metrics in the Prometheus text"
+            << " format,\n"
+            << "                   refreshed every second\n"
+            << "  --overlay        show frames and instructions per second on"
+            << " screen\n"
+            << "  --on-unknown P   unknown opcode policy: nop (default), skip"
+            << " or halt\n"
+            << "  --break ADDR[:VX<op>NN]  stop a replay before the"
+            << " instruction at ADDR,\n"
+            << "                   optionally only when VX compares to NN"
+            << " (op: = ! < >)\n"
+            << "  --watch ADDR     stop a replay after a write to ADDR\n"
+            << "                   (needs a build with -DC8EMU_DEBUGGER=ON)\n"
+            << "  --reverse        replay the whole movie, then go back to"
+            << " the last\n"
+            << "                   breakpoint or watchpoint hit\n"
+            << "  --rewind         keep a history of the session, holding"
+            << " Backspace\n"
+            << "                   plays it backwards\n"
+            << "  --audio-buffer N  audio device buffer in samples at 44.1 kHz"
+            << " (default: 512)\n"
+            << "  --mute           don't open an audio device\n"
+            << "  --wav FILE       with --replay, write the sound to a WAV"
+            << " file"
+            << std::endl;
+}
+
+// loads the ROM given on the command line, from the bundle if there is one
+// (by name, or by content hash in hex)
+static bool load_program(Memory& memory, const char* rom,
+                         const char* bundle_file) {
+  if (!bundle_file) {
+    return memory.load_rom(rom);
+  }
+
+  RomBundle bundle;
+  if (!bundle.open(bundle_file)) {
+    return false;
+  }
+  size_t index = bundle.find(std::string_view(rom));
+  if (index == bundle.size()) {
+    char* end = nullptr;
+    uint64_t rom_hash = std::strtoull(rom, &end, 16);
+    if (end != rom && *end == '\0') {
+      index = bundle.find(rom_hash);
+    }
+  }
+  if (index == bundle.size()) {
+    std::cerr << "No ROM " << rom << " in bundle: " << bundle_file
+              << std::endl;
+    return false;
+  }
+  return bundle.load(index, memory);
+}
+
+static bool write_flamegraph(const CallGraphProfiler& call_graph,
+                             const char* filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Failed to write flamegraph file: " << filename << std::endl;
+    return false;
+  }
+  call_graph.write_collapsed(file);
+  return true;
+}
+
+// parses "ADDR" or "ADDR:VX<op>NN" into the debugger
+static bool parse_breakpoint(const std::string& spec, Debugger& debugger) {
+  char* end = nullptr;
+  unsigned long address = std::strtoul(spec.c_str(), &end, 0);
+  if (end == spec.c_str() || address > Memory::ADDRESS_MASK) {
+    return false;
+  }
+  if (*end == '\0') {
+    debugger.add_breakpoint(uint16_t(address));
+    return true;
+  }
+
+  // condition: ":V" register, comparison, value
+  if (end[0] != ':' || (end[1] != 'V' && end[1] != 'v') ||
+      !std::isxdigit(static_cast<unsigned char>(end[2]))) {
+    return false;
+  }
+  BreakCondition condition;
+  condition.reg = uint8_t(std::stoi(std::string(1, end[2]), nullptr, 16));
+  switch (end[3]) {
+    case '=':
+      condition.compare = BreakCondition::eq;
+      break;
+    case '!':
+      condition.compare = BreakCondition::ne;
+      break;
+    case '<':
+      condition.compare = BreakCondition::lt;
+      break;
+    case '>':
+      condition.compare = BreakCondition::gt;
+      break;
+    default:
+      return false;
+  }
+  if (!end[4]) {
+    return false;
+  }
+  unsigned long value = std::strtoul(end + 4, &end, 0);
+  if (*end != '\0' || value > 0xFF) {
+    return false;
+  }
+  condition.value = uint8_t(value);
+  debugger.add_breakpoint(uint16_t(address), condition);
+  return true;
+}
+
+static void print_stop(CPU& cpu, StopReason reason, const Debugger& debugger,
+                       uint64_t frame) {
+  std::ostream& out = std::cout;
+  out << std::hex;
+  if (reason == StopReason::breakpoint) {
+    out << "breakpoint";
+  } else if (reason == StopReason::watchpoint) {
+    const Debugger::WatchHit& hit = debugger.get_watch_hit();
+    out << (hit.write ? "write" : "read") << " watchpoint at 0x"
+        << hit.address;
+  } else {
+    out << "halted";
+  }
+
+  uint16_t pc = cpu.get_pc();
+  const Memory& memory = cpu.get_memory();
+  uint16_t opcode = memory.read(pc) << 8 | memory.read(pc + 1);
+  out << std::dec << " in frame " << frame << "\n"
+      << std::hex << "pc 0x" << pc << ": " << disassemble(opcode) << "\n";
+  for (int i = 0; i < 16; ++i) {
+    out << "V" << i << "=" << int(cpu.get_registers()[i])
+        << (i % 8 == 7 ? "\n" : " ");
+  }
+  out << "I=" << cpu.get_I() << " sp=" << int(cpu.get_sp()) << std::dec
+      << std::endl;
+}
+
+// live metrics of an interactive session, refreshed once per second into a
+// Prometheus text file and/or the on-screen overlay
+struct SessionMetrics {
+  MetricsRegistry registry;
+  Counter& instructions = registry.counter(
+      "chip8_instructions_total", "Guest instructions executed");
+  Counter& frames =
+      registry.counter("chip8_frames_total", "Frames emulated and rendered");
+  Counter& unknown_opcodes = registry.counter(
+      "chip8_unknown_opcodes_total", "Unknown opcodes encountered");
+  Gauge& instructions_per_second = registry.gauge(
+      "chip8_instructions_per_second", "Guest instructions per second");
+  Gauge& frames_per_second =
+      registry.gauge("chip8_frames_per_second", "Frames per second");
+  Histogram& frame_duration =
+      registry.histogram("chip8_frame_duration_seconds",
+                         "Host time spent emulating and rendering a frame");
+  Histogram& render_time = registry.histogram(
+      "chip8_render_seconds", "Host time spent rendering a frame");
+  Histogram& input_latency = registry.histogram(
+      "chip8_input_to_photon_seconds",
+      "Time from a keypad change to the present of the frame it affected");
+  Histogram& audio_latency = registry.histogram(
+      "chip8_audio_latency_seconds",
+      "Time from the end of a frame to its first sample being played");
+
+  uint64_t last_refresh_ns = timeline::now_ns();
+  uint64_t last_instructions = 0;
+  uint64_t last_frames = 0;
+
+  // returns true when the gauges were refreshed
+  bool refresh(uint64_t now_ns, uint64_t unknown_opcode_count) {
+    double seconds = (now_ns - last_refresh_ns) / 1e9;
+    if (seconds < 1.0) {
+      return false;
+    }
+
+    unknown_opcodes.add(unknown_opcode_count - unknown_opcodes.get());
+    instructions_per_second.set((instructions.get() - last_instructions) /
+                                seconds);
+    frames_per_second.set((frames.get() - last_frames) / seconds);
+
+    last_refresh_ns = now_ns;
+    last_instructions = instructions.get();
+    last_frames = frames.get();
+    return true;
+  }
+};
+
+// plays a movie back without a window, as fast as possible
+static int replay_movie(const char* rom_file, const char* movie_file,
+                        Profiler* profiler, CallGraphProfiler* call_graph,
+                        ExecutionTrace* trace, UnknownOpcodePolicy policy,
+                        Debugger* debugger, bool reverse,
+                        const char* wav_file, const char* bundle_file) {
+  Movie movie;
+  if (!movie.load(movie_file)) {
+    return 1;
+  }
+
+  Memory memory;
+  Display display(true);
+  Input input;
+  CPU cpu(memory, display, input);
+
+  memory.load_font();
+  if (!load_program(memory, rom_file, bundle_file)) {
+    return 1;
+  }
+  if (memory.get_rom_hash() != movie.get_rom_hash()) {
+    std::cerr << "Movie was recorded with a different ROM" << std::endl;
+    return 1;
+  }
+  cpu.seed(movie.get_seed());
+  cpu.set_quirks(movie.get_quirks());
+  cpu.set_trace(trace);
+
+  Diagnostics diagnostics(std::cerr);
+  cpu.set_diagnostics(&diagnostics);
+  cpu.set_unknown_opcode_policy(policy);
+  cpu.set_debugger(debugger);
+#ifdef C8EMU_PROFILE
+  cpu.set_profiler(profiler);
+  cpu.set_call_graph(call_graph);
+#else
+  (void)call_graph;
+#endif
+
+  // the sound is captured at the rate the live output plays it
+  AudioSynth synth(44100);
+  WavWriter wav;
+  if (wav_file && !wav.open(wav_file, synth.get_sample_rate())) {
+    return 1;
+  }
+
+  // movies recorded with --vip-timing have no fixed instruction count
+  int instructions_per_frame = movie.get_instructions_per_frame();
+  std::unique_ptr<VipTiming> timing;
+  if (instructions_per_frame == 0) {
+    if (debugger) {
+      std::cerr << "Breakpoints and watchpoints don't apply to movies"
+                << " recorded with --vip-timing" << std::endl;
+      return 1;
+    }
+    timing = std::make_unique<VipTiming>(cpu);
+  }
+
+  if (debugger && reverse) {
+    // play the whole movie, then look back for the last hit
+    History history(cpu, instructions_per_frame);
+    for (const Movie::Run& run : movie.get_runs()) {
+      history.set_keys(run.keys);
+      for (uint32_t i = 0; i < run.frames; ++i) {
+        history.run_frame();
+      }
+    }
+
+    StopReason reason = history.reverse_continue(*debugger);
+    if (reason == StopReason::completed) {
+      std::cout << "no hit in the last "
+                << history.get_position() - history.get_oldest_position()
+                << " instructions" << std::endl;
+    } else {
+      print_stop(cpu, reason, *debugger,
+                 history.get_position() / instructions_per_frame);
+    }
+    return 0;
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t frame = 0;
+  for (const Movie::Run& run : movie.get_runs()) {
+    input.set_keys(run.keys);
+    for (uint32_t i = 0; i < run.frames; ++i, ++frame) {
+      if (!debugger) {
+        if (timing) {
+          timing->run_frame();
+        } else {
+          cpu.run_frame(instructions_per_frame);
+        }
+        if (wav_file) {
+          synth.render_frame(cpu, wav);
+        }
+        continue;
+      }
+
+      // the replay ends at the first debugger stop
+      StopReason reason = cpu.run<true>(instructions_per_frame);
+      if (reason == StopReason::breakpoint ||
+          reason == StopReason::watchpoint) {
+        print_stop(cpu, reason, *debugger, frame);
+        return wav.close() ? 0 : 1;
+      }
+      cpu.end_frame();
+      if (wav_file) {
+        synth.render_frame(cpu, wav);
+      }
+    }
+  }
+  if (!wav.close()) {
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+
+  std::cout << "frames: " << movie.frame_count() << "\n"
+            << "seconds: " << seconds << "\n"
+            << "state hash: " << std::hex << cpu.state_hash() << std::dec
+            << std::endl;
+  if (profiler) {
+    profiler->report(std::cerr);
+  }
+  return 0;
+}
 
 int main(int argc, char** argv) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <ROM file>" << std::endl;
+  if (argc < 2) {
+    print_usage(argv[0]);
     return 1;
   }
 
+  const char* rom_file = argv[1];
+  const char* record_file = nullptr;
+  const char* replay_file = nullptr;
+  uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+  int instructions_per_frame = 10;
+  bool fixed_speed = false;
+  const char* profiles_file = RomProfiles::DEFAULT_FILE;
+  bool explicit_profiles = false;
+  bool vip_timing = false;
+  bool profile = false;
+  const char* flamegraph_file = nullptr;
+  const char* trace_file = nullptr;
+  const char* timeline_file = nullptr;
+  const char* metrics_file = nullptr;
+  bool overlay = false;
+  UnknownOpcodePolicy unknown_opcode_policy = UnknownOpcodePolicy::nop;
+  QuirkProfile quirks = QuirkProfile::cosmac_vip;
+  bool detect_quirks = true;
+  Debugger debugger;
+  bool debugging = false;
+  [[maybe_unused]] bool watching = false;  // only read without the hooks
+  bool reverse = false;
+  bool rewind = false;
+  int audio_buffer = 512;
+  bool mute = false;
+  const char* wav_file = nullptr;
+  const char* bundle_file = nullptr;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--seed" && has_value) {
+      seed = std::strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "--ipf" && has_value) {
+      instructions_per_frame = std::atoi(argv[++i]);
+      fixed_speed = true;
+    } else if (arg == "--profiles" && has_value) {
+      profiles_file = argv[++i];
+      explicit_profiles = true;
+    } else if (arg == "--vip-timing") {
+      vip_timing = true;
+    } else if (arg == "--quirks" && has_value) {
+      if (!parse_quirk_profile(argv[++i], quirks)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      detect_quirks = false;
+    } else if (arg == "--record" && has_value) {
+      record_file = argv[++i];
+    } else if (arg == "--replay" && has_value) {
+      replay_file = argv[++i];
+    } else if (arg == "--profile") {
+      profile = true;
+    } else if (arg == "--flamegraph" && has_value) {
+      flamegraph_file = argv[++i];
+    } else if (arg == "--trace" && has_value) {
+      trace_file = argv[++i];
+    } else if (arg == "--timeline" && has_value) {
+      timeline_file = argv[++i];
+      timeline::enable();
+    } else if (arg == "--metrics" && has_value) {
+      metrics_file = argv[++i];
+    } else if (arg == "--overlay") {
+      overlay = true;
+    } else if (arg == "--on-unknown" && has_value) {
+      std::string policy = argv[++i];
+      if (policy == "nop") {
+        unknown_opcode_policy = UnknownOpcodePolicy::nop;
+      } else if (policy == "skip") {
+        unknown_opcode_policy = UnknownOpcodePolicy::skip;
+      } else if (policy == "halt") {
+        unknown_opcode_policy = UnknownOpcodePolicy::halt;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--reverse") {
+      reverse = true;
+    } else if (arg == "--rewind") {
+      rewind = true;
+    } else if (arg == "--audio-buffer" && has_value) {
+      audio_buffer = std::atoi(argv[++i]);
+      if (audio_buffer <= 0 || audio_buffer > 8192) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--mute") {
+      mute = true;
+    } else if (arg == "--wav" && has_value) {
+      wav_file = argv[++i];
+    } else if (arg == "--bundle" && has_value) {
+      bundle_file = argv[++i];
+    } else if (arg == "--break" && has_value) {
+      if (!parse_breakpoint(argv[++i], debugger)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      debugging = true;
+    } else if (arg == "--watch" && has_value) {
+      unsigned long address = std::strtoul(argv[++i], nullptr, 0);
+      if (address > Memory::ADDRESS_MASK) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      debugger.add_watchpoint(uint16_t(address), false, true);
+      debugging = true;
+      watching = true;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+#ifndef C8EMU_DEBUGGER
+  if (watching) {
+    std::cerr << "Watchpoints are not available in this build" << std::endl;
+  }
+#endif
+  if (debugging && !replay_file) {
+    std::cerr << "Breakpoints and watchpoints only apply to --replay"
+              << std::endl;
+  }
+  if (wav_file && !replay_file) {
+    std::cerr << "--wav only applies to --replay" << std::endl;
+  }
+  if (rewind && record_file) {
+    // a movie can't express going back in time
+    std::cerr << "--rewind can't be combined with --record" << std::endl;
+    return 1;
+  }
+  if (rewind && vip_timing) {
+    // the history counts a fixed number of instructions per frame
+    std::cerr << "--rewind can't be combined with --vip-timing" << std::endl;
+    return 1;
+  }
+
+#ifndef C8EMU_PROFILE
+  if (profile || flamegraph_file) {
+    std::cerr << "Profiling is not available in this build" << std::endl;
+    profile = false;
+    flamegraph_file = nullptr;
+  }
+#endif
+  Profiler profiler;
+  CallGraphProfiler call_graph;
+  ExecutionTrace trace;
+  if (trace_file) {
+    // kept apart from the exit dump, which would overwrite it
+    trace.set_anomaly_file((std::string(trace_file) + ".anomaly").c_str());
+  }
+
+  if (replay_file) {
+    int result =
+        replay_movie(rom_file, replay_file, profile ? &profiler : nullptr,
+                     flamegraph_file ? &call_graph : nullptr,
+                     trace_file ? &trace : nullptr, unknown_opcode_policy,
+                     debugging ? &debugger : nullptr, reverse, wav_file,
+                     bundle_file);
+    if (flamegraph_file && !write_flamegraph(call_graph, flamegraph_file)) {
+      result = 1;
+    }
+    if (trace_file && !trace.dump(trace_file)) {
+      result = 1;
+    }
+    return result;
+  }
+
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError()
               << std::endl;
@@ -23,21 +562,98 @@ int main(int argc, char** argv) {
   Input input;
 
   CPU cpu(memory, display, input);
+  cpu.seed(seed);
 
-  memory.load_rom(argv[1]);
+  Diagnostics diagnostics(std::cerr);
+  cpu.set_diagnostics(&diagnostics);
+  cpu.set_unknown_opcode_policy(unknown_opcode_policy);
+
+  if (trace_file) {
+    cpu.set_trace(&trace);
+  }
+#ifdef C8EMU_PROFILE
+  if (profile) {
+    cpu.set_profiler(&profiler);
+  }
+  if (flamegraph_file) {
+    cpu.set_call_graph(&call_graph);
+  }
+#endif
+
+  memory.load_font();
+  if (!load_program(memory, rom_file, bundle_file)) {
+    return 1;
+  }
+  if (detect_quirks) {
+    quirks = detect_quirk_profile(memory);
+  }
+  cpu.set_quirks(quirks);
+
+  // the speed calibrated for this ROM, unless one was asked for
+  if (!fixed_speed && !vip_timing) {
+    // the default file is only a hint: a broken one must not stop the ROM
+    RomProfiles profiles;
+    if (!profiles.load(profiles_file)) {
+      if (explicit_profiles) {
+        return 1;
+      }
+      std::cerr << "Ignoring the ROM profiles, running at "
+                << instructions_per_frame << " instructions per frame"
+                << std::endl;
+    } else if (const RomProfile* rom_profile =
+                   profiles.find(memory.get_rom_hash())) {
+      instructions_per_frame = rom_profile->instructions_per_frame;
+    }
+  }
+
+  Movie movie(memory.get_rom_hash(), seed,
+              vip_timing ? 0 : instructions_per_frame, quirks);
+  VipTiming timing(cpu);
+  History history(cpu, instructions_per_frame);
+  bool rewinding = false;
+
+  std::unique_ptr<SdlAudio> audio;
+  if (!mute) {
+    audio = std::make_unique<SdlAudio>(44100, audio_buffer);
+    if (!audio->is_open()) {
+      audio.reset();
+    }
+  }
+  AudioSynth synth(audio ? audio->get_sample_rate() : 44100);
+
+  SessionMetrics metrics;
+  uint64_t pending_input_ns = 0;
 
   // main loop
   bool running = true;
-  auto last_cycle_time = std::chrono::high_resolution_clock::now();
+  auto last_frame_time = std::chrono::high_resolution_clock::now();
   SDL_Event event;
 
   while (running) {
     // handle events (through the input class)
-    while (SDL_PollEvent(&event) != 0) {
-      if (event.type == SDL_QUIT) {
-        running = false;
-      } else {
-        input.handle_event(event);
+    {
+      timeline::Scope scope("poll events");
+      while (SDL_PollEvent(&event) != 0) {
+        if (event.type == SDL_QUIT) {
+          running = false;
+        } else if (profile && event.type == SDL_KEYDOWN &&
+                   event.key.keysym.sym == SDLK_F2) {
+          profiler.report(std::cerr);
+        } else if (trace_file && event.type == SDL_KEYDOWN &&
+                   event.key.keysym.sym == SDLK_F3) {
+          trace.dump(trace_file);
+        } else if (rewind && (event.type == SDL_KEYDOWN ||
+                              event.type == SDL_KEYUP) &&
+                   event.key.keysym.sym == SDLK_BACKSPACE) {
+          rewinding = event.type == SDL_KEYDOWN;
+        } else if (input.handle_event(event)) {
+          if (rewind) {
+            history.set_keys(input.get_keys());
+          }
+          if (!pending_input_ns) {
+            pending_input_ns = timeline::now_ns();
+          }
+        }
       }
     }
 
@@ -45,21 +661,115 @@ int main(int argc, char** argv) {
     auto current_time = std::chrono::high_resolution_clock::now();
     float elapsed_time =
         std::chrono::duration<float, std::chrono::milliseconds::period>(
-            current_time - last_cycle_time)
+            current_time - last_frame_time)
             .count();
 
-    if (elapsed_time > 3.0f) {
-      // update the last cycle time
-      last_cycle_time = current_time;
+    // run at 60 frames per second, the rate the timers count down at
+    const float frame_time = 1000.0f / 60.0f;
+    if (elapsed_time > frame_time) {
+      // update the last frame time
+      last_frame_time = current_time;
+
+      uint64_t frame_start_ns = timeline::now_ns();
+      uint64_t frame_instructions = instructions_per_frame;
 
       // run the CPU
-      cpu.cycle();
+      if (record_file) {
+        movie.record(input.get_keys());
+      }
+      {
+        timeline::Scope scope("cpu frame");
+        if (vip_timing) {
+          uint64_t executed = timing.get_instructions();
+          timing.run_frame();
+          frame_instructions = timing.get_instructions() - executed;
+        } else if (!rewind) {
+          cpu.run_frame(instructions_per_frame);
+        } else if (!rewinding) {
+          history.run_frame();
+        } else {
+          // back to the start of the previous frame, then keep the keys
+          // that are held now
+          uint16_t keys = input.get_keys();
+          uint64_t position = history.get_position();
+          uint64_t frame_start =
+              position - (position - 1) % instructions_per_frame - 1;
+          if (position > 0 && history.seek(frame_start)) {
+            history.set_keys(keys);
+          }
+        }
+      }
+
+      if (audio) {
+        timeline::Scope scope("audio");
+        synth.render_frame(cpu, *audio);
+        metrics.audio_latency.record(audio->get_latency_ns());
+      }
 
       // update the display
+      uint64_t render_start_ns = timeline::now_ns();
       display.render();
+      uint64_t frame_end_ns = timeline::now_ns();
+
+      metrics.instructions.add(frame_instructions);
+      metrics.frames.add();
+      metrics.frame_duration.record(frame_end_ns - frame_start_ns);
+      metrics.render_time.record(frame_end_ns - render_start_ns);
+      if (pending_input_ns) {
+        metrics.input_latency.record(frame_end_ns - pending_input_ns);
+        pending_input_ns = 0;
+      }
+
+      if (metrics.refresh(frame_end_ns, cpu.get_unknown_opcode_count())) {
+        if (metrics_file) {
+          metrics.registry.write_prometheus(metrics_file);
+        }
+        if (overlay) {
+          display.set_overlay(
+              std::to_string(int(metrics.frames_per_second.get())) + " " +
+              std::to_string(int(metrics.instructions_per_second.get())));
+        }
+      }
+    } else if (frame_time - elapsed_time > 2.0f) {
+      // sleep through most of the wait instead of spinning, leaving a
+      // millisecond of slack for the scheduler
+      timeline::Scope scope("sleep");
+      SDL_Delay(Uint32(frame_time - elapsed_time) - 1);
     }
   }
 
+  // every output is attempted even if an earlier one fails, so that one bad
+  // path doesn't lose the recorded movie
+  bool written = true;
+  if (timeline_file && !timeline::write_chrome_trace(timeline_file)) {
+    written = false;
+  }
+
+  if (audio) {
+    std::cerr << "audio: " << audio->get_buffer_samples()
+              << " sample buffer, latency "
+              << metrics.audio_latency.quantile(0.5) / 1000000.0
+              << " ms median, "
+              << metrics.audio_latency.quantile(0.99) / 1000000.0
+              << " ms p99, " << audio->get_underruns() << " underruns, "
+              << audio->get_dropped() << " samples dropped" << std::endl;
+  }
+
+  if (profile) {
+    profiler.report(std::cerr);
+  }
+  if (flamegraph_file && !write_flamegraph(call_graph, flamegraph_file)) {
+    written = false;
+  }
+  if (trace_file && !trace.dump(trace_file)) {
+    written = false;
+  }
+
+  if (record_file && !movie.save(record_file)) {
+    written = false;
+  }
+
+  audio.reset();
   SDL_Quit();
-  return 0;
+  return written ? 0 : 1;
 }
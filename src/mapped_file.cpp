@@ -0,0 +1,69 @@
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define C8EMU_HAS_MMAP
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+#ifdef C8EMU_HAS_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+
+  length = size_t(info.st_size);
+  if (length > 0) {
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd);
+      length = 0;
+      return false;
+    }
+    view = static_cast<const uint8_t*>(address);
+    mapped = true;
+  }
+  // the mapping stays valid without the descriptor
+  ::close(fd);
+#else
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  buffer.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  view = buffer.data();
+  length = buffer.size();
+#endif
+
+  opened = true;
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef C8EMU_HAS_MMAP
+  if (mapped) {
+    munmap(const_cast<uint8_t*>(view), length);
+  }
+#endif
+  buffer.clear();
+  view = nullptr;
+  length = 0;
+  opened = false;
+  mapped = false;
+}
@@ -2,44 +2,144 @@
 
 #include <stddef.h>
 
-#include <fstream>
-#include <iosfwd>
+#include <algorithm>
 #include <iostream>
 
+#include "debugger.h"
+#include "mapped_file.h"
+
 // initialize memory with zeroes
-Memory::Memory() { memory.fill(0); }
+Memory::Memory() {
+  memory.fill(0);
+  hash = 0;
+  rom_size = 0;
+}
 
-// method to load ROMs (games) into memory
-void Memory::load_rom(const char* filename) {
-  // open file in binary mode and seek to the end
-  std::ifstream file(filename, std::ios::binary | std::ios::ate);
-  if (file.is_open()) {
-    std::streampos size = file.tellg();  // get file size
-    file.seekg(0, std::ios::beg);        // seek to beginning of file
-    file.read(reinterpret_cast<char*>(&memory[0x200]),
-              size);  // read file into memory starting at 0x200, which is the
-                      // start of the ROM-destined space in memory
-    file.close();
+std::string RomError::message() const {
+  switch (code) {
+    case Code::none:
+      return "";
+    case Code::open_failed:
+      return "Failed to open ROM file: " + source;
+    case Code::empty:
+      return "ROM is empty: " + source;
+    case Code::corrupt:
+      return "ROM doesn't match its content hash: " + source;
+    case Code::too_large: {
+      std::string text = "ROM is " + std::to_string(size) +
+                         " bytes, more than the " + std::to_string(limit) +
+                         " that fit in memory";
+#ifndef C8EMU_MEMORY_64K
+      text += " (XO-CHIP programs need a C8EMU_MEMORY_64K build)";
+#endif
+      return text + ": " + source;
+    }
+  }
+  return "";
+}
+
+bool RomError::report(Code code, const std::string& source, size_t size,
+                      RomError* error) {
+  RomError failure;
+  failure.code = code;
+  failure.source = source;
+  failure.size = size;
+  failure.limit = Memory::MAX_ROM_SIZE;
+  if (error) {
+    *error = failure;
   } else {
-    std::cerr << "Failed to load ROM file: " << filename << std::endl;
-    exit(1);
+    std::cerr << failure.message() << std::endl;
+  }
+  return false;
+}
+
+// method to load ROMs (games) into memory
+bool Memory::load_rom(const char* filename, RomError* error) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    return RomError::report(RomError::Code::open_failed, filename, 0, error);
   }
+  return load_rom(file.data(), file.size(), filename, error);
 }
 
-// method to load fontset into memory (starts at 0x50)
+bool Memory::load_rom(const uint8_t* data, size_t size,
+                      const std::string& source, RomError* error) {
+  if (size == 0) {
+    return RomError::report(RomError::Code::empty, source, size, error);
+  }
+  if (size > MAX_ROM_SIZE) {
+    return RomError::report(RomError::Code::too_large, source, size, error);
+  }
+
+  // whatever a previous program left after the image goes too
+  std::copy_n(data, size, &memory[ROM_START]);
+  std::fill(memory.begin() + ROM_START + size, memory.end(), 0);
+  rom_size = size;
+  rehash();
+  return true;
+}
+
+// method to get the content hash of the loaded ROM image
+// (identifies the ROM in movies and per-ROM profiles)
+uint64_t Memory::get_rom_hash() const {
+  return hash_bytes(&memory[0x200], rom_size);
+}
+
+// method to load fontset into memory (starts at 0x50, followed by the
+// SUPER-CHIP big font at 0xA0)
 void Memory::load_font() {
   for (size_t i = 0; i < fontset.size(); i++) {
     memory[0x50 + i] = fontset[i];
   }
+  for (size_t i = 0; i < bigfontset.size(); i++) {
+    memory[0xA0 + i] = bigfontset[i];
+  }
+  rehash();
 }
 
 // method to read from memory
-uint8_t Memory::read(uint16_t address) const { return memory[address]; }
+// addresses wrap around the address space, so a runaway I or pc can't read
+// past the array
+// (instruction fetches go through here too, so they trip read watchpoints)
+uint8_t Memory::read(uint16_t address) const {
+  address &= ADDRESS_MASK;
+#ifdef C8EMU_DEBUGGER
+  if (debugger) {
+    debugger->on_read(address);
+  }
+#endif
+  return memory[address];
+}
 
 // method to write to memory
-void Memory::write(uint16_t address, uint8_t value) { memory[address] = value; }
+// the old byte's key is xored out and the new one in, so the hash never needs
+// a full scan after the initial load
+void Memory::write(uint16_t address, uint8_t value) {
+  address &= ADDRESS_MASK;
+#ifdef C8EMU_DEBUGGER
+  if (debugger) {
+    debugger->on_write(address);
+  }
+#endif
+  hash ^= memory_key(address, memory[address]) ^ memory_key(address, value);
+  memory[address] = value;
+}
 
 // method to get a pointer to a memory address
 const uint8_t* Memory::get_pointer(uint16_t address) const {
   return &memory[address];
 }
+
+// method to recompute the hash from scratch (after bulk loads)
+void Memory::rehash() {
+  hash = 0;
+  for (size_t i = 0; i < memory.size(); i++) {
+    hash ^= memory_key(i, memory[i]);
+  }
+}
+
+// method to restore the memory contents from a snapshot
+void Memory::restore(const Data& data, uint64_t data_hash) {
+  memory = data;
+  hash = data_hash;
+}
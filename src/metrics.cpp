@@ -0,0 +1,132 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+uint64_t Histogram::count() const {
+  return total_count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+  return total_sum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::bucket_upper_bound(int index) {
+  if (index < SUB_BUCKETS) {
+    return uint64_t(index);
+  }
+  int shift = index / SUB_BUCKETS - 1;
+  uint64_t sub_bucket = uint64_t(index % SUB_BUCKETS) | SUB_BUCKETS;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+uint64_t Histogram::quantile(double fraction) const {
+  uint64_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+
+  uint64_t rank = uint64_t(fraction * (total - 1)) + 1;
+  uint64_t seen = 0;
+  for (int index = 0; index < BUCKET_COUNT; ++index) {
+    seen += buckets[index].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return bucket_upper_bound(index);
+    }
+  }
+  return bucket_upper_bound(BUCKET_COUNT - 1);
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find_or_add(const std::string& name,
+                                                     const std::string& help,
+                                                     Type type) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& entry : entries) {
+    if (entry->name == name) {
+      return *entry;
+    }
+  }
+
+  auto entry = std::make_unique<Entry>();
+  entry->name = name;
+  entry->help = help;
+  entry->type = type;
+  switch (type) {
+    case Type::counter:
+      entry->counter = std::make_unique<Counter>();
+      break;
+    case Type::gauge:
+      entry->gauge = std::make_unique<Gauge>();
+      break;
+    case Type::histogram:
+      entry->histogram = std::make_unique<Histogram>();
+      break;
+  }
+  entries.push_back(std::move(entry));
+  return *entries.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name,
+                                  const std::string& help) {
+  return *find_or_add(name, help, Type::counter).counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name,
+                              const std::string& help) {
+  return *find_or_add(name, help, Type::gauge).gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name,
+                                      const std::string& help) {
+  return *find_or_add(name, help, Type::histogram).histogram;
+}
+
+std::string MetricsRegistry::to_prometheus() const {
+  std::ostringstream out;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (const auto& entry : entries) {
+    out << "# HELP " << entry->name << ' ' << entry->help << '\n';
+    switch (entry->type) {
+      case Type::counter:
+        out << "# TYPE " << entry->name << " counter\n"
+            << entry->name << ' ' << entry->counter->get() << '\n';
+        break;
+      case Type::gauge:
+        out << "# TYPE " << entry->name << " gauge\n"
+            << entry->name << ' ' << entry->gauge->get() << '\n';
+        break;
+      case Type::histogram: {
+        // exported as a summary, the buckets are too fine for Prometheus
+        const Histogram& histogram = *entry->histogram;
+        out << "# TYPE " << entry->name << " summary\n";
+        for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+          out << entry->name << "{quantile=\"" << quantile << "\"} "
+              << histogram.quantile(quantile) / 1e9 << '\n';
+        }
+        out << entry->name << "_sum " << histogram.sum() / 1e9 << '\n'
+            << entry->name << "_count " << histogram.count() << '\n';
+        break;
+      }
+    }
+  }
+  return out.str();
+}
+
+bool MetricsRegistry::write_prometheus(const std::string& filename) const {
+  std::string temporary = filename + ".tmp";
+  {
+    std::ofstream file(temporary);
+    if (!file.is_open()) {
+      std::cerr << "Failed to write metrics file: " << filename << std::endl;
+      return false;
+    }
+    file << to_prometheus();
+    if (!file) {
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
@@ -0,0 +1,141 @@
+#include "movie.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[4] = {'C', '8', 'M', 'V'};
+
+template <typename T>
+void write_le(std::ostream& out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out.put(char((value >> (8 * i)) & 0xFF));
+  }
+}
+
+template <typename T>
+bool read_le(std::istream& in, T& value) {
+  value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    int byte = in.get();
+    if (byte == EOF) {
+      return false;
+    }
+    value |= T(uint8_t(byte)) << (8 * i);
+  }
+  return true;
+}
+
+void write_varint(std::ostream& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.put(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.put(char(value));
+}
+
+bool read_varint(std::istream& in, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int byte = in.get();
+    if (byte == EOF) {
+      return false;
+    }
+    value |= uint32_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+Movie::Movie()
+    : rom_hash(0),
+      seed(0),
+      instructions_per_frame(0),
+      quirks(QuirkProfile::cosmac_vip) {}
+
+Movie::Movie(uint64_t rom_hash, uint64_t seed, uint16_t instructions_per_frame,
+             QuirkProfile quirks)
+    : rom_hash(rom_hash),
+      seed(seed),
+      instructions_per_frame(instructions_per_frame),
+      quirks(quirks) {}
+
+void Movie::record(uint16_t keys) {
+  if (!runs.empty() && runs.back().keys == keys &&
+      runs.back().frames < UINT32_MAX) {
+    ++runs.back().frames;
+  } else {
+    runs.push_back({keys, 1});
+  }
+}
+
+size_t Movie::frame_count() const {
+  size_t frames = 0;
+  for (const Run& run : runs) {
+    frames += run.frames;
+  }
+  return frames;
+}
+
+bool Movie::save(const char* filename) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open movie file for writing: " << filename
+              << std::endl;
+    return false;
+  }
+
+  file.write(MAGIC, sizeof(MAGIC));
+  write_le(file, VERSION);
+  write_le(file, instructions_per_frame);
+  write_le(file, rom_hash);
+  write_le(file, seed);
+  write_le(file, uint8_t(quirks));
+  write_le(file, uint32_t(runs.size()));
+  for (const Run& run : runs) {
+    write_le(file, run.keys);
+    write_varint(file, run.frames);
+  }
+  return bool(file);
+}
+
+bool Movie::load(const char* filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open movie file: " << filename << std::endl;
+    return false;
+  }
+
+  char magic[sizeof(MAGIC)];
+  uint16_t version = 0;
+  uint8_t quirk_profile = 0;
+  uint32_t run_count = 0;
+  if (!file.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      !read_le(file, version) || version != VERSION ||
+      !read_le(file, instructions_per_frame) || !read_le(file, rom_hash) ||
+      !read_le(file, seed) || !read_le(file, quirk_profile) ||
+      quirk_profile > uint8_t(QuirkProfile::xo_chip) ||
+      !read_le(file, run_count)) {
+    std::cerr << "Invalid movie header: " << filename << std::endl;
+    return false;
+  }
+  quirks = QuirkProfile(quirk_profile);
+
+  runs.clear();
+  for (uint32_t i = 0; i < run_count; ++i) {
+    Run run;
+    if (!read_le(file, run.keys) || !read_varint(file, run.frames)) {
+      std::cerr << "Truncated movie file: " << filename << std::endl;
+      return false;
+    }
+    runs.push_back(run);
+  }
+  return true;
+}
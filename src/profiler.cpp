@@ -0,0 +1,89 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+Profiler::Profiler() { reset(); }
+
+void Profiler::reset() {
+  family_counts.fill(0);
+  family_ticks.fill(0);
+  family_samples.fill(0);
+  pc_counts.fill(0);
+  sample_countdown = SAMPLE_INTERVAL;
+  start_ticks = ticks();
+  start_time = std::chrono::steady_clock::now();
+}
+
+void Profiler::report(std::ostream& out) const {
+  // the formatting below is undone at the end, out belongs to the caller
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  char fill = out.fill();
+
+  // calibrate the tick rate over the profiled interval
+  double elapsed_ns = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start_time)
+                          .count();
+  uint64_t elapsed_ticks = ticks() - start_ticks;
+  double ns_per_tick = elapsed_ticks ? elapsed_ns / elapsed_ticks : 0.0;
+
+  uint64_t total = 0;
+  for (uint64_t count : family_counts) {
+    total += count;
+  }
+
+  std::vector<size_t> families;
+  for (size_t family = 0; family < OPCODE_FAMILY_COUNT; ++family) {
+    if (family_counts[family]) {
+      families.push_back(family);
+    }
+  }
+  // extrapolate the sampled time to every execution of the family
+  auto family_ns = [&](size_t family) {
+    if (!family_samples[family]) {
+      return 0.0;
+    }
+    return double(family_ticks[family]) * ns_per_tick *
+           family_counts[family] / family_samples[family];
+  };
+  std::sort(families.begin(), families.end(), [&](size_t a, size_t b) {
+    return family_ns(a) > family_ns(b);
+  });
+
+  out << "opcode       count      %     total ms   ns/op\n";
+  for (size_t family : families) {
+    double ns = family_ns(family);
+    out << std::left << std::setw(8) << opcode_family_names[family]
+        << std::right << std::setw(10) << family_counts[family] << std::fixed
+        << std::setprecision(2) << std::setw(7)
+        << 100.0 * family_counts[family] / total << std::setw(13)
+        << ns / 1e6 << std::setw(8) << ns / family_counts[family] << '\n';
+  }
+
+  std::vector<uint16_t> pcs;
+  for (size_t pc = 0; pc < pc_counts.size(); ++pc) {
+    if (pc_counts[pc]) {
+      pcs.push_back(uint16_t(pc));
+    }
+  }
+  size_t shown = std::min<size_t>(pcs.size(), 20);
+  std::partial_sort(pcs.begin(), pcs.begin() + shown, pcs.end(),
+                    [this](uint16_t a, uint16_t b) {
+                      return pc_counts[a] > pc_counts[b];
+                    });
+
+  out << "\nhottest pcs:\n";
+  for (size_t i = 0; i < shown; ++i) {
+    out << "  0x" << std::hex << std::setw(3) << std::setfill('0') << pcs[i]
+        << std::dec << std::setfill(' ') << std::setw(12) << pc_counts[pcs[i]]
+        << std::setw(7) << 100.0 * pc_counts[pcs[i]] / total << "%\n";
+  }
+  out << "total: " << total << " instructions" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+  out.fill(fill);
+}
@@ -0,0 +1,81 @@
+#include "quirks.h"
+
+#include "analysis.h"
+#include "memory.h"
+
+const char* quirk_profile_name(QuirkProfile profile) {
+  switch (profile) {
+    case QuirkProfile::chip48:
+      return "chip48";
+    case QuirkProfile::schip:
+      return "schip";
+    case QuirkProfile::xo_chip:
+      return "xochip";
+    case QuirkProfile::cosmac_vip:
+    default:
+      return "vip";
+  }
+}
+
+bool parse_quirk_profile(const std::string& name, QuirkProfile& profile) {
+  for (QuirkProfile candidate :
+       {QuirkProfile::cosmac_vip, QuirkProfile::chip48, QuirkProfile::schip,
+        QuirkProfile::xo_chip}) {
+    if (name == quirk_profile_name(candidate)) {
+      profile = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace {
+
+bool is_xo_chip_opcode(uint16_t opcode) {
+  switch (opcode & 0xF000u) {
+    case 0x0000:
+      return (opcode & 0xFFF0u) == 0x00D0;  // 00DN scroll up
+    case 0x5000:
+      return (opcode & 0x000Fu) == 0x2 || (opcode & 0x000Fu) == 0x3;
+    case 0xF000:
+      return opcode == 0xF000 || opcode == 0xF002 ||
+             (opcode & 0x00FFu) == 0x01 || (opcode & 0x00FFu) == 0x3A;
+    default:
+      return false;
+  }
+}
+
+bool is_schip_opcode(uint16_t opcode) {
+  switch (opcode & 0xF000u) {
+    case 0x0000:
+      return (opcode & 0xFFF0u) == 0x00C0 || (opcode >= 0x00FB &&
+                                             opcode <= 0x00FF);
+    case 0xD000:
+      return (opcode & 0x000Fu) == 0;  // 16x16 sprite
+    case 0xF000:
+      return (opcode & 0x00FFu) == 0x30 || (opcode & 0x00FFu) == 0x75 ||
+             (opcode & 0x00FFu) == 0x85;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+QuirkProfile detect_quirk_profile(const Memory& memory) {
+  ProgramAnalysis analysis(memory.get_data(), 0x200, memory.get_rom_size());
+
+  bool schip = false;
+  for (const auto& entry : analysis.get_blocks()) {
+    const BasicBlock& block = entry.second;
+    for (uint32_t address = block.start; address < block.end; address += 2) {
+      uint16_t opcode = memory.get_data()[address] << 8 |
+                        memory.get_data()[(address + 1) & Memory::ADDRESS_MASK];
+      if (is_xo_chip_opcode(opcode)) {
+        return QuirkProfile::xo_chip;
+      }
+      schip = schip || is_schip_opcode(opcode);
+    }
+  }
+  return schip ? QuirkProfile::schip : QuirkProfile::cosmac_vip;
+}
@@ -0,0 +1,223 @@
+#include "rom_bundle.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "binary_format.h"
+#include "state_hash.h"
+
+namespace {
+
+const char MAGIC[4] = {'C', '8', 'B', 'N'};
+
+uint64_t align_up(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+bool RomBundle::write(const std::string& filename, std::vector<Rom> roms) {
+  std::sort(roms.begin(), roms.end(),
+            [](const Rom& a, const Rom& b) { return a.name < b.name; });
+  for (size_t i = 1; i < roms.size(); ++i) {
+    if (roms[i].name == roms[i - 1].name) {
+      std::cerr << "Two ROMs named " << roms[i].name << " in the bundle"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // strings first, so the payloads can be placed after them
+  StringPool strings;
+  std::vector<uint8_t> entries;
+
+  for (const Rom& rom : roms) {
+    const RomMetadata& metadata = rom.metadata;
+    store_le(entries, metadata.rom_hash);
+    store_le(entries, uint32_t(0));  // payload offset, patched below
+    store_le(entries, uint32_t(rom.data.size()));
+    store_le(entries, uint8_t(metadata.platform));
+    entries.insert(entries.end(), 15, 0);
+    strings.add(entries, rom.name);
+    strings.add(entries, metadata.title);
+    strings.add(entries, metadata.credits);
+    strings.add(entries, metadata.summary);
+  }
+
+  uint64_t string_offset = HEADER_SIZE + roms.size() * ENTRY_SIZE;
+  uint64_t payload_offset = string_offset + strings.bytes.size();
+  std::vector<uint64_t> payload_offsets(roms.size());
+  for (size_t i = 0; i < roms.size(); ++i) {
+    payload_offset = align_up(payload_offset, PAYLOAD_ALIGNMENT);
+    payload_offsets[i] = payload_offset;
+    payload_offset += roms[i].data.size();
+  }
+  uint64_t file_size = payload_offset;
+  if (file_size > UINT32_MAX) {
+    std::cerr << "Bundle would be larger than 4 GB: " << filename
+              << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < roms.size(); ++i) {
+    store_le(&entries[i * ENTRY_SIZE + 8], uint32_t(payload_offsets[i]));
+  }
+
+  std::vector<uint8_t> header(MAGIC, MAGIC + 4);
+  store_le(header, VERSION);
+  store_le(header, uint16_t(ENTRY_SIZE));
+  store_le(header, uint32_t(roms.size()));
+  store_le(header, PAYLOAD_ALIGNMENT);
+  store_le(header, uint32_t(string_offset));
+  store_le(header, uint32_t(strings.bytes.size()));
+  store_le(header, file_size);
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Failed to open bundle for writing: " << filename
+              << std::endl;
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(header.data()),
+            std::streamsize(header.size()));
+  out.write(reinterpret_cast<const char*>(entries.data()),
+            std::streamsize(entries.size()));
+  out.write(strings.bytes.data(), std::streamsize(strings.bytes.size()));
+  uint64_t position = string_offset + strings.bytes.size();
+  for (size_t i = 0; i < roms.size(); ++i) {
+    for (; position < payload_offsets[i]; ++position) {
+      out.put('\0');
+    }
+    out.write(reinterpret_cast<const char*>(roms[i].data.data()),
+              std::streamsize(roms[i].data.size()));
+    position += roms[i].data.size();
+  }
+  if (!out) {
+    std::cerr << "Failed to write bundle: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool RomBundle::open(const std::string& new_filename) {
+  close();
+  filename = new_filename;
+  if (!file.open(filename)) {
+    std::cerr << "Failed to open ROM bundle: " << filename << std::endl;
+    return false;
+  }
+
+  auto invalid = [&](const char* reason) {
+    std::cerr << "Invalid ROM bundle (" << reason << "): " << filename
+              << std::endl;
+    close();
+    return false;
+  };
+
+  const uint8_t* data = file.data();
+  uint64_t file_size = file.size();
+  if (file_size < HEADER_SIZE || std::memcmp(data, MAGIC, 4) != 0 ||
+      load_le<uint16_t>(data + 4) != VERSION ||
+      load_le<uint16_t>(data + 6) != ENTRY_SIZE) {
+    return invalid("header");
+  }
+  uint64_t entries = load_le<uint32_t>(data + 8);
+  uint32_t alignment = load_le<uint32_t>(data + 12);
+  uint64_t string_offset = load_le<uint32_t>(data + 16);
+  uint64_t string_bytes = load_le<uint32_t>(data + 20);
+  if (load_le<uint64_t>(data + 24) != file_size) {
+    return invalid("truncated");
+  }
+  if (alignment == 0 || string_offset < HEADER_SIZE + entries * ENTRY_SIZE ||
+      string_offset + string_bytes > file_size) {
+    return invalid("layout");
+  }
+  strings = reinterpret_cast<const char*>(data + string_offset);
+
+  // checked once here so that lookups and loads can trust every entry
+  for (size_t i = 0; i < entries; ++i) {
+    const uint8_t* rom = data + HEADER_SIZE + i * ENTRY_SIZE;
+    uint64_t payload_offset = load_le<uint32_t>(rom + 8);
+    uint64_t payload_size = load_le<uint32_t>(rom + 12);
+    if (payload_offset % alignment != 0 ||
+        payload_offset + payload_size > file_size ||
+        rom[16] > uint8_t(QuirkProfile::xo_chip)) {
+      return invalid("entry");
+    }
+    for (size_t field = 32; field < ENTRY_SIZE; field += 8) {
+      if (!string_fits(rom + field, string_bytes)) {
+        return invalid("entry");
+      }
+    }
+    // find(name) is a binary search
+    if (i > 0 && !(string_at(rom - ENTRY_SIZE + 32) < string_at(rom + 32))) {
+      return invalid("order");
+    }
+  }
+
+  count = size_t(entries);
+  return true;
+}
+
+void RomBundle::close() {
+  file.close();
+  count = 0;
+  strings = nullptr;
+}
+
+std::string_view RomBundle::string_at(const uint8_t* field) const {
+  return load_string(strings, field);
+}
+
+RomInfo RomBundle::get(size_t i) const {
+  const uint8_t* rom = entry(i);
+  RomInfo info;
+  info.rom_hash = load_le<uint64_t>(rom);
+  info.size = load_le<uint32_t>(rom + 12);
+  info.platform = QuirkProfile(rom[16]);
+  info.path = string_at(rom + 32);
+  info.title = string_at(rom + 40);
+  info.credits = string_at(rom + 48);
+  info.summary = string_at(rom + 56);
+  return info;
+}
+
+const uint8_t* RomBundle::get_payload(size_t i) const {
+  return file.data() + load_le<uint32_t>(entry(i) + 8);
+}
+
+size_t RomBundle::find(std::string_view name) const {
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (string_at(entry(middle) + 32) < name) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < count && string_at(entry(low) + 32) == name ? low : count;
+}
+
+size_t RomBundle::find(uint64_t rom_hash) const {
+  for (size_t i = 0; i < count; ++i) {
+    if (load_le<uint64_t>(entry(i)) == rom_hash) {
+      return i;
+    }
+  }
+  return count;
+}
+
+bool RomBundle::load(size_t i, Memory& memory, RomError* error) const {
+  RomInfo info = get(i);
+  const uint8_t* payload = get_payload(i);
+  std::string source = filename + ":" + std::string(info.path);
+
+  if (hash_bytes(payload, info.size) != info.rom_hash) {
+    return RomError::report(RomError::Code::corrupt, source, info.size,
+                            error);
+  }
+  return memory.load_rom(payload, info.size, source, error);
+}
@@ -0,0 +1,339 @@
+#include "rom_library.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "binary_format.h"
+#include "memory.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[4] = {'C', '8', 'L', 'I'};
+const size_t MAX_SUMMARY = 120;
+
+}  // namespace
+
+bool is_rom_file(const std::string& path) {
+  std::string extension = fs::path(path).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return char(std::tolower(c)); });
+  return extension == ".ch8" || extension == ".c8" || extension == ".sc8" ||
+         extension == ".xo8";
+}
+
+namespace {
+
+uint64_t modification_time(const fs::path& path) {
+  std::error_code error;
+  auto time = fs::last_write_time(path, error);
+  return error ? 0 : uint64_t(time.time_since_epoch().count());
+}
+
+// words of text separated by single spaces
+std::string collapse_spaces(std::string_view text) {
+  std::string out;
+  for (char c : text) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      if (!out.empty() && out.back() != ' ') {
+        out += ' ';
+      }
+    } else {
+      out += c;
+    }
+  }
+  if (!out.empty() && out.back() == ' ') {
+    out.pop_back();
+  }
+  return out;
+}
+
+// "Title [credits] (alt)" into "Title (alt)" and "credits"
+void split_name(const std::string& stem, std::string& title,
+                std::string& credits) {
+  size_t open = stem.find('[');
+  size_t close = open == std::string::npos ? open : stem.find(']', open);
+  if (close == std::string::npos) {
+    title = collapse_spaces(stem);
+    credits.clear();
+    return;
+  }
+  title = collapse_spaces(stem.substr(0, open) + " " + stem.substr(close + 1));
+  credits = collapse_spaces(stem.substr(open + 1, close - open - 1));
+}
+
+// the first line of the sidecar with words on it (not just a rule)
+std::string read_summary(const fs::path& path) {
+  MappedFile file;
+  if (!file.open(path.string())) {
+    return "";
+  }
+  std::string_view text(reinterpret_cast<const char*>(file.data()),
+                        file.size());
+  while (!text.empty()) {
+    size_t end = std::min(text.find('\n'), text.size());
+    std::string line = collapse_spaces(text.substr(0, end));
+    if (std::any_of(line.begin(), line.end(),
+                    [](unsigned char c) { return std::isalnum(c); })) {
+      return line.substr(0, MAX_SUMMARY);
+    }
+    text.remove_prefix(std::min(end + 1, text.size()));
+  }
+  return "";
+}
+
+// the next index being put together
+struct IndexBuilder {
+  std::vector<uint8_t> records;
+  StringPool strings;
+  uint32_t count = 0;
+
+  void add(const RomInfo& info, uint64_t rom_time, uint64_t sidecar_time) {
+    store_le(records, info.rom_hash);
+    store_le(records, rom_time);
+    store_le(records, sidecar_time);
+    store_le(records, info.size);
+    store_le(records, uint8_t(info.platform));
+    records.insert(records.end(), 3, 0);
+    strings.add(records, info.path);
+    strings.add(records, info.title);
+    strings.add(records, info.credits);
+    strings.add(records, info.summary);
+    ++count;
+  }
+};
+
+}  // namespace
+
+bool describe_rom(const std::string& rom_path, const uint8_t* data,
+                  size_t size, RomMetadata& metadata, RomError* error) {
+  Memory memory;
+  if (!memory.load_rom(data, size, rom_path, error)) {
+    return false;
+  }
+
+  fs::path path(rom_path);
+  fs::path sidecar_path = fs::path(path).replace_extension(".txt");
+  std::error_code exists_error;
+  split_name(path.stem().string(), metadata.title, metadata.credits);
+  metadata.summary = fs::exists(sidecar_path, exists_error)
+                         ? read_summary(sidecar_path)
+                         : "";
+  metadata.rom_hash = memory.get_rom_hash();
+  metadata.size = uint32_t(size);
+  metadata.platform = detect_quirk_profile(memory);
+  return true;
+}
+
+bool RomLibrary::open(const std::string& index_file) {
+  close();
+  if (!index.open(index_file)) {
+    return false;
+  }
+
+  const uint8_t* data = index.data();
+  size_t file_size = index.size();
+  if (file_size < HEADER_SIZE || std::memcmp(data, MAGIC, 4) != 0 ||
+      load_le<uint16_t>(data + 4) != VERSION ||
+      load_le<uint16_t>(data + 6) != RECORD_SIZE) {
+    close();
+    return false;
+  }
+  uint64_t records = load_le<uint32_t>(data + 8);
+  uint64_t string_bytes = load_le<uint32_t>(data + 12);
+  if (HEADER_SIZE + records * RECORD_SIZE + string_bytes != file_size) {
+    close();
+    return false;
+  }
+
+  // checked once here so that get() can trust every record
+  for (size_t i = 0; i < records; ++i) {
+    const uint8_t* entry = data + HEADER_SIZE + i * RECORD_SIZE;
+    if (entry[28] > uint8_t(QuirkProfile::xo_chip)) {
+      close();
+      return false;
+    }
+    for (size_t field = 32; field < RECORD_SIZE; field += 8) {
+      if (!string_fits(entry + field, string_bytes)) {
+        close();
+        return false;
+      }
+    }
+  }
+
+  count = size_t(records);
+  strings = reinterpret_cast<const char*>(data + HEADER_SIZE +
+                                          records * RECORD_SIZE);
+  return true;
+}
+
+void RomLibrary::close() {
+  index.close();
+  count = 0;
+  strings = nullptr;
+}
+
+std::string_view RomLibrary::string_at(const uint8_t* field) const {
+  return load_string(strings, field);
+}
+
+RomInfo RomLibrary::get(size_t i) const {
+  const uint8_t* entry = record(i);
+  RomInfo info;
+  info.rom_hash = load_le<uint64_t>(entry);
+  info.size = load_le<uint32_t>(entry + 24);
+  info.platform = QuirkProfile(entry[28]);
+  info.path = string_at(entry + 32);
+  info.title = string_at(entry + 40);
+  info.credits = string_at(entry + 48);
+  info.summary = string_at(entry + 56);
+  return info;
+}
+
+bool RomLibrary::find(uint64_t rom_hash, RomInfo& info) const {
+  for (size_t i = 0; i < count; ++i) {
+    if (load_le<uint64_t>(record(i)) == rom_hash) {
+      info = get(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t RomLibrary::find_path(std::string_view path) const {
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (string_at(record(middle) + 32) < path) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < count && string_at(record(low) + 32) == path ? low : count;
+}
+
+bool RomLibrary::update(const std::string& directory,
+                        const std::string& index_file,
+                        LibraryScanStats* stats) {
+  auto start_time = std::chrono::steady_clock::now();
+  LibraryScanStats scan;
+  if (!index.is_open()) {
+    open(index_file);
+  }
+
+  std::error_code error;
+  std::vector<std::string> paths;
+  fs::recursive_directory_iterator it(directory, error);
+  if (error) {
+    std::cerr << "Failed to scan ROM directory: " << directory << std::endl;
+    return false;
+  }
+  for (; it != fs::recursive_directory_iterator(); it.increment(error)) {
+    if (error) {
+      break;
+    }
+    if (it->is_regular_file(error) && is_rom_file(it->path().string())) {
+      paths.push_back(fs::relative(it->path(), directory, error)
+                          .generic_string());
+    }
+  }
+  // the records are kept sorted by path for find_path()
+  std::sort(paths.begin(), paths.end());
+
+  IndexBuilder builder;
+  for (const std::string& path : paths) {
+    fs::path rom_path = fs::path(directory) / path;
+    fs::path sidecar_path = fs::path(rom_path).replace_extension(".txt");
+    uint64_t rom_time = modification_time(rom_path);
+    uint64_t sidecar_time =
+        fs::exists(sidecar_path, error) ? modification_time(sidecar_path) : 0;
+    uint64_t file_size = fs::file_size(rom_path, error);
+    if (error) {
+      ++scan.skipped;
+      continue;
+    }
+
+    size_t old = find_path(path);
+    if (old < count) {
+      const uint8_t* entry = record(old);
+      if (load_le<uint64_t>(entry + 8) == rom_time &&
+          load_le<uint64_t>(entry + 16) == sidecar_time &&
+          load_le<uint32_t>(entry + 24) == file_size) {
+        builder.add(get(old), rom_time, sidecar_time);
+        ++scan.reused;
+        continue;
+      }
+    }
+
+    MappedFile rom;
+    RomMetadata metadata;
+    RomError rom_error;
+    if (!rom.open(rom_path.string())) {
+      std::cerr << "Skipping unreadable ROM: " << path << std::endl;
+      ++scan.skipped;
+      continue;
+    }
+    if (!describe_rom(rom_path.string(), rom.data(), rom.size(), metadata,
+                      &rom_error)) {
+      std::cerr << "Skipping " << rom_error.message() << std::endl;
+      ++scan.skipped;
+      continue;
+    }
+
+    RomInfo info = metadata.info();
+    info.path = path;
+    builder.add(info, rom_time, sidecar_time);
+    ++scan.read;
+  }
+  scan.roms = builder.count;
+
+  // nothing read again and nothing gone: the index is still right
+  if (scan.read > 0 || scan.roms != count) {
+    std::vector<uint8_t> header(MAGIC, MAGIC + 4);
+    store_le(header, VERSION);
+    store_le(header, uint16_t(RECORD_SIZE));
+    store_le(header, builder.count);
+    store_le(header, uint32_t(builder.strings.bytes.size()));
+
+    // written aside and renamed over, so a reader never maps half an index
+    std::string temporary = index_file + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(header.data()),
+                 std::streamsize(header.size()));
+      file.write(reinterpret_cast<const char*>(builder.records.data()),
+                 std::streamsize(builder.records.size()));
+      file.write(builder.strings.bytes.data(),
+                 std::streamsize(builder.strings.bytes.size()));
+      if (!file) {
+        std::cerr << "Failed to write ROM library index: " << temporary
+                  << std::endl;
+        return false;
+      }
+    }
+    fs::rename(temporary, index_file, error);
+    if (error || !open(index_file)) {
+      std::cerr << "Failed to replace ROM library index: " << index_file
+                << std::endl;
+      return false;
+    }
+    scan.written = true;
+  }
+
+  scan.seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start_time)
+                     .count();
+  if (stats) {
+    *stats = scan;
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+#include "rom_profile.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+bool RomProfiles::load(const char* filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return true;
+  }
+
+  std::string line;
+  int number = 0;
+  while (std::getline(file, line)) {
+    ++number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    uint64_t rom_hash = 0;
+    RomProfile profile;
+    if (!(fields >> std::hex >> rom_hash >> std::dec >>
+          profile.instructions_per_frame) ||
+        profile.instructions_per_frame <= 0) {
+      std::cerr << "Invalid ROM profile at " << filename << ":" << number
+                << std::endl;
+      return false;
+    }
+    profiles[rom_hash] = profile;
+  }
+  return true;
+}
+
+bool RomProfiles::save(const char* filename) const {
+  std::ofstream file(filename, std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Failed to write ROM profiles: " << filename << std::endl;
+    return false;
+  }
+
+  file << "# ROM hash, instructions per frame\n";
+  for (const auto& entry : profiles) {
+    file << std::hex << std::setw(16) << std::setfill('0') << entry.first
+         << std::dec << ' ' << entry.second.instructions_per_frame << '\n';
+  }
+  return bool(file);
+}
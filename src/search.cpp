@@ -0,0 +1,337 @@
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+
+#include "display.h"
+#include "input.h"
+#include "memory.h"
+#include "visited_set.h"
+
+namespace {
+
+const uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+// search tree node, only what is needed to rebuild the input path
+struct Node {
+  uint32_t parent;
+  uint16_t keys;
+};
+
+// a queued state, kept as the 8-byte words in which its snapshot differs
+// from the root: runs of a (u32 first word, u32 count) header followed by
+// the words
+// states a few inputs apart from the root differ in some registers, a few
+// memory bytes and part of the screen, so this is usually a small fraction
+// of the snapshot (about 6 KB, 66 KB with C8EMU_MEMORY_64K)
+class PackedState {
+ public:
+  void pack(const Snapshot& root, const Snapshot& state) {
+    words.clear();
+    size_t i = 0;
+    while (i < WORDS) {
+      if (word(state, i) == word(root, i)) {
+        ++i;
+        continue;
+      }
+      size_t header = words.size();
+      words.push_back(0);
+      size_t first = i;
+      for (; i < WORDS && word(state, i) != word(root, i); ++i) {
+        words.push_back(word(state, i));
+      }
+      words[header] = uint64_t(first) << 32 | (i - first);
+    }
+    words.shrink_to_fit();
+  }
+
+  void unpack(const Snapshot& root, Snapshot& state) const {
+    state = root;
+    auto* out = reinterpret_cast<uint8_t*>(&state);
+    for (size_t i = 0; i < words.size(); i += 1 + (words[i] & 0xFFFFFFFF)) {
+      size_t first = size_t(words[i] >> 32);
+      size_t count = size_t(words[i] & 0xFFFFFFFF);
+      std::memcpy(out + first * sizeof(uint64_t), &words[i + 1],
+                  count * sizeof(uint64_t));
+    }
+  }
+
+  size_t bytes() const { return words.capacity() * sizeof(uint64_t); }
+
+ private:
+  static_assert(std::is_trivially_copyable<Snapshot>::value &&
+                    sizeof(Snapshot) % sizeof(uint64_t) == 0,
+                "snapshots are packed as an array of words");
+  static const size_t WORDS = sizeof(Snapshot) / sizeof(uint64_t);
+
+  static uint64_t word(const Snapshot& snapshot, size_t i) {
+    uint64_t value;
+    std::memcpy(&value,
+                reinterpret_cast<const uint8_t*>(&snapshot) +
+                    i * sizeof(uint64_t),
+                sizeof(value));
+    return value;
+  }
+
+  std::vector<uint64_t> words;
+};
+
+struct FrontierEntry {
+  int64_t priority;
+  uint64_t order;
+  uint32_t node;
+  int depth;
+  PackedState state;
+
+  // highest priority first, ties in insertion order (plain FIFO for BFS)
+  bool operator<(const FrontierEntry& other) const {
+    if (priority != other.priority) {
+      return priority < other.priority;
+    }
+    return order > other.order;
+  }
+
+  size_t bytes() const { return sizeof(FrontierEntry) + state.bytes(); }
+};
+
+// a new state found while expanding an entry
+struct Child {
+  uint16_t keys;
+  bool queued;  // false past max_depth
+  int64_t priority;
+  PackedState state;
+};
+
+class Frontier {
+ public:
+  Frontier(FrontierEntry root, size_t max_memory)
+      : nodes{{NO_PARENT, 0}}, max_memory(max_memory) {
+    memory = root.bytes() + sizeof(Node);
+    queue.push(std::move(root));
+  }
+
+  // blocks until an entry is available, returns false once the search is over
+  bool pop(FrontierEntry& entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [this] { return done || !queue.empty() || active == 0; });
+    if (done || queue.empty()) {
+      done = true;
+      ready.notify_all();
+      return false;
+    }
+    // the entry is moved out just before pop() drops it
+    entry = std::move(const_cast<FrontierEntry&>(queue.top()));
+    queue.pop();
+    memory -= entry.bytes();
+    ++active;
+    return true;
+  }
+
+  // records the children of an expanded entry under a single lock and queues
+  // the ones to expand; goal, if set, is the last child, full stops the
+  // search after them
+  void finish_entry(const FrontierEntry& entry, std::vector<Child>& children,
+                    bool goal, bool full) {
+    std::lock_guard<std::mutex> lock(mutex);
+    --active;
+    for (size_t i = 0; i < children.size(); ++i) {
+      Child& child = children[i];
+      nodes.push_back({entry.node, child.keys});
+      uint32_t node = uint32_t(nodes.size() - 1);
+      memory += sizeof(Node);
+      if (goal && i + 1 == children.size()) {
+        if (goal_node == NO_PARENT) {
+          goal_node = node;
+        }
+        done = true;
+      } else if (child.queued && !done) {
+        FrontierEntry next{child.priority, next_order++, node, entry.depth + 1,
+                           std::move(child.state)};
+        memory += next.bytes();
+        queue.push(std::move(next));
+      }
+    }
+    peak_memory = std::max(peak_memory, memory);
+    if (memory > max_memory) {
+      out_of_memory = true;
+      done = true;
+    }
+    done = done || full;
+    ready.notify_all();
+  }
+
+  std::vector<uint16_t> path() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint16_t> inputs;
+    for (uint32_t n = goal_node; n != NO_PARENT && nodes[n].parent != NO_PARENT;
+         n = nodes[n].parent) {
+      inputs.push_back(nodes[n].keys);
+    }
+    std::reverse(inputs.begin(), inputs.end());
+    return inputs;
+  }
+
+  bool found() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return goal_node != NO_PARENT;
+  }
+
+  size_t get_peak_memory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return peak_memory;
+  }
+
+  bool is_out_of_memory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return out_of_memory;
+  }
+
+ private:
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::priority_queue<FrontierEntry> queue;
+  std::vector<Node> nodes;
+  uint64_t next_order = 1;
+  unsigned active = 0;
+  bool done = false;
+  uint32_t goal_node = NO_PARENT;
+
+  // bytes held by the queued states and the nodes
+  size_t memory = 0;
+  size_t peak_memory = 0;
+  size_t max_memory;
+  bool out_of_memory = false;
+};
+
+}  // namespace
+
+SearchResult search(const Snapshot& root, const SearchOptions& options) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  std::vector<uint16_t> inputs = options.inputs;
+  if (inputs.empty()) {
+    inputs.push_back(0);
+    for (int key = 0; key < 16; ++key) {
+      inputs.push_back(uint16_t(1u << key));
+    }
+  }
+
+  unsigned thread_count = options.threads;
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  bool best_first =
+      options.strategy == SearchOptions::Strategy::best_first && options.score;
+
+  // the children are the only states checked below, so a root that already
+  // meets the goal is reached with no inputs at all
+  if (options.goal) {
+    Memory memory;
+    Display display(true);
+    Input input;
+    CPU cpu(memory, display, input);
+    cpu.set_quirks(options.quirks);
+    cpu.load_snapshot(root);
+    if (options.goal(cpu)) {
+      SearchResult result;
+      result.found = true;
+      result.states_visited = 1;
+      result.seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_time)
+                           .count();
+      return result;
+    }
+  }
+
+  VisitedSet visited;
+  std::atomic<size_t> visited_count{1};
+  std::atomic<size_t> expanded_count{0};
+
+  Frontier frontier({0, 0, 0, 0, PackedState()}, options.max_memory);
+
+  auto worker = [&]() {
+    // every worker owns a full headless machine
+    Memory memory;
+    Display display(true);
+    Input input;
+    CPU cpu(memory, display, input);
+
+    cpu.set_quirks(options.quirks);
+    cpu.load_snapshot(root);
+    visited.insert(cpu.state_hash());
+
+    FrontierEntry entry;
+    Snapshot parent{};
+    Snapshot child_snapshot{};
+    std::vector<Child> children;
+    while (frontier.pop(entry)) {
+      entry.state.unpack(root, parent);
+      children.clear();
+      bool goal = false;
+      bool full = false;
+
+      for (uint16_t keys : inputs) {
+        cpu.load_snapshot(parent);
+        input.set_keys(keys);
+        for (int frame = 0; frame < options.frames_per_input; ++frame) {
+          cpu.run_frame(options.instructions_per_frame);
+        }
+        ++expanded_count;
+
+        if (!visited.insert(cpu.state_hash())) {
+          continue;
+        }
+
+        Child& child = children.emplace_back();
+        child.keys = keys;
+        child.queued = false;
+        if (options.goal && options.goal(cpu)) {
+          goal = true;
+          break;
+        }
+        if (++visited_count >= options.max_states) {
+          full = true;
+          break;
+        }
+
+        int depth = entry.depth + 1;
+        if (depth < options.max_depth) {
+          cpu.save_snapshot(child_snapshot);
+          child.state.pack(root, child_snapshot);
+          child.priority = best_first ? options.score(cpu) : -depth;
+          child.queued = true;
+        }
+      }
+      frontier.finish_entry(entry, children, goal, full);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  SearchResult result;
+  result.found = frontier.found();
+  result.inputs = frontier.path();
+  result.states_expanded = expanded_count;
+  result.states_visited = visited.size();
+  result.peak_memory = frontier.get_peak_memory();
+  result.out_of_memory = frontier.is_out_of_memory();
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+  return result;
+}
@@ -0,0 +1,90 @@
+#include "timeline.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace timeline {
+
+std::atomic<bool> enabled{false};
+
+namespace {
+
+// a thread stops recording once its buffer is full rather than growing it
+const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+struct Event {
+  const char* name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+};
+
+struct ThreadBuffer {
+  int thread_id;
+  std::vector<Event> events;
+};
+
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+const auto epoch = std::chrono::steady_clock::now();
+
+// buffers are registered once per thread and owned by the global list, so
+// they outlive their threads and can be exported at any time
+ThreadBuffer& thread_buffer() {
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = buffers.back().get();
+    buffer->thread_id = int(buffers.size());
+    buffer->events.reserve(4096);
+  }
+  return *buffer;
+}
+
+}  // namespace
+
+void enable() { enabled.store(true, std::memory_order_relaxed); }
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+  ThreadBuffer& buffer = thread_buffer();
+  if (buffer.events.size() < MAX_EVENTS_PER_THREAD) {
+    buffer.events.push_back({name, start_ns, end_ns});
+  }
+}
+
+// meant to be called once the traced threads are done (at exit)
+bool write_chrome_trace(const char* filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Failed to write timeline file: " << filename << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [\n";
+  bool first = true;
+  for (const auto& buffer : buffers) {
+    for (const Event& event : buffer->events) {
+      file << (first ? "" : ",\n") << "{\"name\": \"" << event.name
+           << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_id
+           << ", \"ts\": " << event.start_ns / 1000.0
+           << ", \"dur\": " << (event.end_ns - event.start_ns) / 1000.0 << "}";
+      first = false;
+    }
+  }
+  file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  return bool(file);
+}
+
+}  // namespace timeline
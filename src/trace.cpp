@@ -0,0 +1,97 @@
+#include "trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[4] = {'C', '8', 'T', 'R'};
+
+}  // namespace
+
+ExecutionTrace::ExecutionTrace(size_t capacity_log2)
+    : records(size_t(1) << capacity_log2),
+      mask(records.size() - 1),
+      head(0),
+      anomaly_pending(false),
+      anomaly_dumped(false) {}
+
+size_t ExecutionTrace::size() const {
+  uint64_t position = head.load(std::memory_order_acquire);
+  return position < records.size() ? size_t(position) : records.size();
+}
+
+bool ExecutionTrace::dump(const char* filename) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to write trace file: " << filename << std::endl;
+    return false;
+  }
+
+  uint64_t position = head.load(std::memory_order_acquire);
+  uint32_t count = uint32_t(size());
+  uint16_t version = VERSION;
+  uint16_t record_size = sizeof(TraceRecord);
+
+  file.write(MAGIC, sizeof(MAGIC));
+  file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  file.write(reinterpret_cast<const char*>(&record_size), sizeof(record_size));
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (uint64_t i = position - count; i < position; ++i) {
+    file.write(reinterpret_cast<const char*>(&records[i & mask]),
+               sizeof(TraceRecord));
+  }
+  return bool(file);
+}
+
+void ExecutionTrace::set_anomaly_file(const char* filename) {
+  anomaly_file = filename;
+  anomaly_pending = false;
+  anomaly_dumped = false;
+}
+
+void ExecutionTrace::anomaly() {
+  // reported from inside the instruction, before record() has seen it
+  anomaly_pending = !anomaly_dumped && !anomaly_file.empty();
+}
+
+void ExecutionTrace::dump_anomaly() {
+  anomaly_pending = false;
+  anomaly_dumped = true;
+  if (dump(anomaly_file.c_str())) {
+    std::cerr << "Execution trace written to " << anomaly_file << std::endl;
+  }
+}
+
+bool ExecutionTrace::load(const char* filename,
+                          std::vector<TraceRecord>& records) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open trace file: " << filename << std::endl;
+    return false;
+  }
+
+  char magic[sizeof(MAGIC)];
+  uint16_t version = 0;
+  uint16_t record_size = 0;
+  uint32_t count = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      version != VERSION || record_size != sizeof(TraceRecord)) {
+    std::cerr << "Invalid trace file: " << filename << std::endl;
+    return false;
+  }
+
+  records.resize(count);
+  file.read(reinterpret_cast<char*>(records.data()),
+            std::streamsize(count) * sizeof(TraceRecord));
+  if (!file) {
+    std::cerr << "Truncated trace file: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,227 @@
+#include "vip_timing.h"
+
+#include <algorithm>
+
+#include "CPU.h"
+#include "input.h"
+
+namespace {
+
+// the instruction costs below are estimates of the machine cycles of the VIP
+// interpreter's routines, built from their structure (the fetch and decode
+// loop every instruction goes through, plus the routine of the instruction,
+// with its loops counted per iteration); they have not been checked against
+// the interpreter listing, so this isn't cycle-exact yet
+const uint32_t FETCH_CYCLES = 40;
+const uint32_t SKIP_CYCLES = 8;  // extra for a skip that is taken
+
+// 00E0 clears the 256 bytes of display memory one at a time
+const uint32_t CLEAR_CYCLES = 24 + 256 * 4;
+
+// 8XYN writes the 1802 instruction for N after a return into RAM, calls it
+// and copies DF to VF; the variants only differ in that one instruction, so
+// they all cost the same
+const uint32_t ALU_CYCLES = 44;
+
+// FX0A calls the keypad routine of the monitor ROM, which spins until a key
+// goes down, stores it, then spins again until it comes back up; only the
+// way out of each loop is counted, the spinning is idle time
+const uint32_t KEY_PRESS_CYCLES = 8;
+const uint32_t KEY_RELEASE_CYCLES = 12;
+
+// DXYN goes a row at a time: the sprite byte is shifted into place one bit
+// at a time and XORed into one display byte, or into two when the sprite
+// isn't aligned on a byte; rows below the screen are skipped
+uint32_t draw_cycles(uint8_t x, uint8_t y, int rows) {
+  int shift = x & 7;
+  int visible = std::min(rows, 32 - (y & 31));
+  uint32_t row_cycles = shift ? 46 + 6 * shift : 26;
+  return 68 + uint32_t(visible) * row_cycles;
+}
+
+// FX33 finds each digit by repeated subtraction
+uint32_t bcd_cycles(uint8_t value) {
+  uint32_t subtractions = value / 100 + value / 10 % 10 + value % 10;
+  return 24 + 16 * subtractions;
+}
+
+}  // namespace
+
+bool EventScheduler::later(const Entry& a, const Entry& b) {
+  return a.cycle != b.cycle ? a.cycle > b.cycle : a.order > b.order;
+}
+
+void EventScheduler::schedule(uint64_t cycle, Event event) {
+  heap.push_back({cycle, scheduled++, event});
+  std::push_heap(heap.begin(), heap.end(), later);
+}
+
+EventScheduler::Event EventScheduler::pop() {
+  std::pop_heap(heap.begin(), heap.end(), later);
+  Event event = heap.back().event;
+  heap.pop_back();
+  return event;
+}
+
+void EventScheduler::clear() {
+  heap.clear();
+  scheduled = 0;
+}
+
+VipTiming::VipTiming(CPU& cpu) : cpu(cpu) { reset(); }
+
+void VipTiming::reset() {
+  // the machine starts as if an interrupt had just come
+  cycle = 0;
+  frame = 0;
+  instructions = 0;
+  interrupted = 0;
+  stalled = true;
+  waiting = false;
+  draw_ready = false;
+  idle = false;
+  held_key = NO_KEY;
+  scheduler.clear();
+  scheduler.schedule(DISPLAY_CYCLES, EventScheduler::Event::display_end);
+  scheduler.schedule(FRAME_CYCLES, EventScheduler::Event::interrupt);
+}
+
+void VipTiming::run_frame() {
+  while (true) {
+    uint64_t next = scheduler.next_cycle();
+    while (!stalled && !waiting && !idle && !cpu.is_halted() &&
+           cycle < next) {
+      execute();
+    }
+
+    // a key may have changed, let the keypad loop look again
+    idle = false;
+    if (scheduler.pop() == EventScheduler::Event::display_end) {
+      stalled = false;
+      cycle = next + interrupted;
+      continue;
+    }
+
+    // the interrupt: whatever is left of the instruction in progress waits
+    // for the display, a waiting DXYN can go on after it
+    interrupted = cycle > next ? cycle - next : 0;
+    stalled = true;
+    if (waiting) {
+      waiting = false;
+      draw_ready = true;
+    }
+    scheduler.schedule(next + DISPLAY_CYCLES,
+                       EventScheduler::Event::display_end);
+    scheduler.schedule(next + FRAME_CYCLES, EventScheduler::Event::interrupt);
+    ++frame;
+    cpu.end_frame();
+    return;
+  }
+}
+
+void VipTiming::execute() {
+  const Memory::Data& data = cpu.get_memory().get_data();
+  uint16_t pc = cpu.get_pc();
+  uint16_t opcode = uint16_t(data[pc & Memory::ADDRESS_MASK] << 8 |
+                             data[(pc + 1) & Memory::ADDRESS_MASK]);
+
+  // FX0A still holding on to the key it returned
+  const Input& input = cpu.get_input();
+  if (held_key != NO_KEY) {
+    if (input.is_key_down(held_key)) {
+      idle = true;
+      return;
+    }
+    held_key = NO_KEY;
+    cycle += KEY_RELEASE_CYCLES;
+  }
+
+  if ((opcode & 0xF000) == 0xD000) {
+    if (!draw_ready) {
+      waiting = true;
+      return;
+    }
+    draw_ready = false;
+  }
+
+  if ((opcode & 0xF0FF) == 0xF00A) {
+    // the key CPU::step() will store
+    for (uint8_t key = 0; key < 16 && held_key == NO_KEY; ++key) {
+      if (input.is_key_down(key)) {
+        held_key = key;
+      }
+    }
+    if (held_key == NO_KEY) {
+      idle = true;
+      return;
+    }
+  }
+
+  cycle += instruction_cycles(opcode);
+  cpu.step();
+  ++instructions;
+}
+
+uint32_t VipTiming::instruction_cycles(uint16_t opcode) const {
+  const uint8_t* V = cpu.get_registers();
+  uint8_t x = (opcode & 0x0F00) >> 8;
+  uint8_t vx = V[x];
+  uint8_t vy = V[(opcode & 0x00F0) >> 4];
+  uint8_t nn = opcode & 0x00FF;
+  bool key = cpu.get_input().is_key_down(vx & 0xF);
+
+  switch (opcode & 0xF000) {
+    case 0x0000:
+      if (opcode == 0x00E0) {
+        return FETCH_CYCLES + CLEAR_CYCLES;
+      }
+      return FETCH_CYCLES + 10;  // 00EE, machine code routines
+    case 0x1000:
+      return FETCH_CYCLES + 12;
+    case 0x2000:
+      return FETCH_CYCLES + 26;
+    case 0x3000:
+      return FETCH_CYCLES + 10 + (vx == nn ? SKIP_CYCLES : 0);
+    case 0x4000:
+      return FETCH_CYCLES + 10 + (vx != nn ? SKIP_CYCLES : 0);
+    case 0x5000:
+      return FETCH_CYCLES + 14 + (vx == vy ? SKIP_CYCLES : 0);
+    case 0x6000:
+      return FETCH_CYCLES + 6;
+    case 0x7000:
+      return FETCH_CYCLES + 10;
+    case 0x8000:
+      return FETCH_CYCLES + ALU_CYCLES;
+    case 0x9000:
+      return FETCH_CYCLES + 14 + (vx != vy ? SKIP_CYCLES : 0);
+    case 0xA000:
+      return FETCH_CYCLES + 8;
+    case 0xB000:
+      return FETCH_CYCLES + 22;
+    case 0xC000:
+      return FETCH_CYCLES + 36;
+    case 0xD000:
+      return FETCH_CYCLES + draw_cycles(vx, vy, opcode & 0x000F);
+    case 0xE000:
+      if (nn == 0x9E) {
+        return FETCH_CYCLES + 14 + (key ? SKIP_CYCLES : 0);
+      }
+      return FETCH_CYCLES + 14 + (!key ? SKIP_CYCLES : 0);
+    default:
+      switch (nn) {
+        case 0x1E:
+          return FETCH_CYCLES + 12;
+        case 0x29:
+          return FETCH_CYCLES + 16;
+        case 0x33:
+          return FETCH_CYCLES + bcd_cycles(vx);
+        case 0x55:
+        case 0x65:
+          return FETCH_CYCLES + 14 + 14 * (x + 1u);
+        case 0x0A:
+          return FETCH_CYCLES + KEY_PRESS_CYCLES;  // once the key is down
+        default:
+          return FETCH_CYCLES + 8;  // FX07, FX15, FX18
+      }
+  }
+}
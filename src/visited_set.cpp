@@ -0,0 +1,37 @@
+#include "visited_set.h"
+
+VisitedSet::VisitedSet(size_t shard_bits)
+    : shard_bits(shard_bits), shards(size_t(1) << shard_bits) {}
+
+// the hashes are already well mixed, so the top bits pick the shard
+VisitedSet::Shard& VisitedSet::shard_for(uint64_t hash) const {
+  return shards[shard_bits ? hash >> (64 - shard_bits) : 0];
+}
+
+bool VisitedSet::insert(uint64_t hash) {
+  Shard& shard = shard_for(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.hashes.insert(hash).second;
+}
+
+bool VisitedSet::contains(uint64_t hash) const {
+  Shard& shard = shard_for(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.hashes.count(hash) != 0;
+}
+
+size_t VisitedSet::size() const {
+  size_t total = 0;
+  for (Shard& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.hashes.size();
+  }
+  return total;
+}
+
+void VisitedSet::clear() {
+  for (Shard& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.hashes.clear();
+  }
+}
@@ -0,0 +1,152 @@
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "binary_format.h"
+
+namespace {
+
+const size_t HEADER_SIZE = 44;
+
+// canonical 44-byte header of a PCM file
+void make_header(uint8_t* header, int sample_rate, uint32_t data_size) {
+  std::copy_n("RIFF", 4, header);
+  store_le(header + 4, uint32_t(36 + data_size));
+  std::copy_n("WAVEfmt ", 8, header + 8);
+  store_le(header + 16, uint32_t(16));               // fmt chunk size
+  store_le(header + 20, uint16_t(1));                // PCM
+  store_le(header + 22, uint16_t(1));                // mono
+  store_le(header + 24, uint32_t(sample_rate));      // samples per second
+  store_le(header + 28, uint32_t(sample_rate * 2));  // bytes per second
+  store_le(header + 32, uint16_t(2));                // bytes per sample
+  store_le(header + 34, uint16_t(16));               // bits per sample
+  std::copy_n("data", 4, header + 36);
+  store_le(header + 40, data_size);
+}
+
+}  // namespace
+
+WavWriter::WavWriter() = default;
+
+WavWriter::~WavWriter() { close(); }
+
+bool WavWriter::open(const std::string& new_filename, int new_sample_rate) {
+  filename = new_filename;
+  sample_rate = new_sample_rate;
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open WAV file for writing: " << filename
+              << std::endl;
+    return false;
+  }
+
+  // the sizes are filled in by close()
+  uint8_t header[HEADER_SIZE];
+  make_header(header, sample_rate, 0);
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  block.reserve(BLOCK_SAMPLES);
+  writer = std::thread(&WavWriter::run, this);
+  return true;
+}
+
+void WavWriter::write(const int16_t* samples, size_t count) {
+  if (!writer.joinable()) {
+    return;
+  }
+  if (count > MAX_SAMPLES - sample_count) {
+    if (!truncated) {
+      std::cerr << "WAV file reached its 4 GB limit, the rest of the sound"
+                << " is not captured: " << filename << std::endl;
+      truncated = true;
+    }
+    count = size_t(MAX_SAMPLES - sample_count);
+  }
+  sample_count += count;
+  while (count > 0) {
+    size_t room = BLOCK_SAMPLES - block.size();
+    size_t taken = count < room ? count : room;
+    block.insert(block.end(), samples, samples + taken);
+    samples += taken;
+    count -= taken;
+    if (block.size() == BLOCK_SAMPLES) {
+      submit_block();
+    }
+  }
+}
+
+void WavWriter::submit_block() {
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending.size() < MAX_PENDING_BLOCKS; });
+  pending.push_back(std::move(block));
+
+  if (!spare.empty()) {
+    block = std::move(spare.back());
+    spare.pop_back();
+  } else {
+    block = std::vector<int16_t>();
+    block.reserve(BLOCK_SAMPLES);
+  }
+  block.clear();
+  lock.unlock();
+  wake.notify_one();
+}
+
+// runs on the writer thread
+void WavWriter::run() {
+  std::vector<char> bytes;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return stopping || !pending.empty(); });
+    if (pending.empty()) {
+      return;  // stopping with nothing left
+    }
+    std::vector<int16_t> samples = std::move(pending.front());
+    pending.pop_front();
+    lock.unlock();
+
+    // little-endian whatever the host is
+    bytes.resize(samples.size() * 2);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      uint16_t sample = uint16_t(samples[i]);
+      bytes[2 * i] = char(sample & 0xFF);
+      bytes[2 * i + 1] = char(sample >> 8);
+    }
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+
+    lock.lock();
+    failed = failed || !file;
+    spare.push_back(std::move(samples));
+    done.notify_one();
+  }
+}
+
+bool WavWriter::close() {
+  if (!writer.joinable()) {
+    return !failed && !truncated;
+  }
+
+  if (!block.empty()) {
+    submit_block();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  uint8_t header[HEADER_SIZE];
+  make_header(header, sample_rate, uint32_t(sample_count * 2));
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.close();
+
+  if (failed || !file) {
+    std::cerr << "Failed to write WAV file: " << filename << std::endl;
+    failed = true;
+    return false;
+  }
+  return !truncated;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CPU.h"
+#include "display.h"
+#include "input.h"
+#include "memory.h"
+#include "quirks.h"
+#include "state_hash.h"
+
+// golden-frame regression suite: runs every ROM of the corpus headless with a
+// fixed seed and scripted input, folds the framebuffer hash of every frame
+// into a digest, and compares the digest at checkpoints with the stored
+// golden ones
+// every frame counts because ROMs that redraw after a CLS in a loop can be
+// blank at any one frame, the checkpoints included
+// ROMs are sharded across threads, and the per-ROM instruction throughput is
+// printed so the suite doubles as a benchmark
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int FRAMES = 1200;
+const int CHECKPOINT_INTERVAL = 300;
+const int INSTRUCTIONS_PER_FRAME = 10;
+const uint64_t SEED = 0xC8;
+
+// CHIP-48 programs that detect_quirk_profile() runs as COSMAC VIP, where
+// they never draw anything
+const std::map<std::string, QuirkProfile> QUIRK_OVERRIDES = {
+    {"games/Blinky [Hans Christian Egeberg] (alt).ch8", QuirkProfile::chip48},
+};
+
+struct RomRun {
+  std::string name;
+  fs::path path;
+  std::vector<uint64_t> hashes;
+  bool drawn = false;  // some frame had lit pixels
+  double instructions_per_second = 0.0;
+};
+
+// scripted input: every key in turn, held for 20 frames, with 10 idle frames
+// in between so that games waiting for a key release move on
+uint16_t scripted_keys(int frame) {
+  int slot = frame / 30;
+  if (frame % 30 >= 20) {
+    return 0;
+  }
+  return uint16_t(1u << (slot % 16));
+}
+
+void run_rom(RomRun& run) {
+  Memory memory;
+  Display display(true);
+  Input input;
+  CPU cpu(memory, display, input);
+  cpu.seed(SEED);
+
+  memory.load_font();
+  if (!memory.load_rom(run.path.string().c_str())) {
+    return;  // no hashes, reported as a mismatch
+  }
+  auto override = QUIRK_OVERRIDES.find(run.name);
+  cpu.set_quirks(override != QUIRK_OVERRIDES.end()
+                     ? override->second
+                     : detect_quirk_profile(memory));
+
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t digest = 0;
+  for (int frame = 1; frame <= FRAMES; ++frame) {
+    input.set_keys(scripted_keys(frame));
+    cpu.run_frame(INSTRUCTIONS_PER_FRAME);
+
+    // a cleared low resolution screen hashes to 0
+    uint64_t hash = display.get_hash();
+    run.drawn = run.drawn || hash != 0;
+    digest = mix64(digest ^ hash);
+    if (frame % CHECKPOINT_INTERVAL == 0) {
+      run.hashes.push_back(digest);
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+  run.instructions_per_second =
+      double(FRAMES) * INSTRUCTIONS_PER_FRAME / std::max(seconds, 1e-9);
+}
+
+std::map<std::string, std::vector<uint64_t>> load_golden(const char* filename) {
+  std::map<std::string, std::vector<uint64_t>> golden;
+  std::ifstream file(filename);
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t tab = line.find('\t');
+    if (line.empty() || line[0] == '#' || tab == std::string::npos) {
+      continue;
+    }
+    std::istringstream hashes(line.substr(tab + 1));
+    std::vector<uint64_t>& entry = golden[line.substr(0, tab)];
+    std::string hash;
+    while (hashes >> hash) {
+      entry.push_back(std::strtoull(hash.c_str(), nullptr, 16));
+    }
+  }
+  return golden;
+}
+
+bool save_golden(const char* filename, const std::vector<RomRun>& runs) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Failed to write golden file: " << filename << std::endl;
+    return false;
+  }
+  file << "# digests of every frame's framebuffer hash, taken every "
+       << CHECKPOINT_INTERVAL << " frames, regenerate with --update\n";
+  for (const RomRun& run : runs) {
+    file << run.name << '\t';
+    for (size_t i = 0; i < run.hashes.size(); ++i) {
+      file << (i ? " " : "") << std::hex << std::setw(16) << std::setfill('0')
+           << run.hashes[i];
+    }
+    file << '\n';
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <ROM directory> <golden file> [--update] [--threads N]"
+              << std::endl;
+    return 1;
+  }
+
+  fs::path rom_dir = argv[1];
+  const char* golden_file = argv[2];
+  bool update = false;
+  unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      thread_count = std::max(1, std::atoi(argv[++i]));
+    }
+  }
+
+  std::vector<RomRun> runs;
+  for (const auto& entry : fs::recursive_directory_iterator(rom_dir)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".ch8") {
+      RomRun run;
+      run.name = fs::relative(entry.path(), rom_dir).generic_string();
+      run.path = entry.path();
+      runs.push_back(run);
+    }
+  }
+  std::sort(runs.begin(), runs.end(),
+            [](const RomRun& a, const RomRun& b) { return a.name < b.name; });
+
+  // shard the corpus across threads
+  auto start_time = std::chrono::steady_clock::now();
+  std::atomic<size_t> next_rom{0};
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers.emplace_back([&]() {
+      for (size_t rom = next_rom++; rom < runs.size(); rom = next_rom++) {
+        run_rom(runs[rom]);
+      }
+    });
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count();
+
+  if (update) {
+    // a ROM that never draws would pass whatever the emulator does
+    bool blank = false;
+    for (const RomRun& run : runs) {
+      if (!run.drawn) {
+        std::cerr << "Nothing drawn in " << FRAMES << " frames: " << run.name
+                  << std::endl;
+        blank = true;
+      }
+    }
+    if (blank) {
+      std::cerr << "Golden file not updated" << std::endl;
+      return 1;
+    }
+    return save_golden(golden_file, runs) ? 0 : 1;
+  }
+
+  auto golden = load_golden(golden_file);
+  int failures = 0;
+  for (const RomRun& run : runs) {
+    auto expected = golden.find(run.name);
+    bool passed = expected != golden.end() && expected->second == run.hashes;
+    if (!passed) {
+      ++failures;
+    }
+    std::cout << (passed ? "ok   " : "FAIL ") << std::fixed
+              << std::setprecision(0) << std::setw(12)
+              << run.instructions_per_second << " ips  " << run.name << '\n';
+  }
+
+  std::cout << runs.size() - failures << "/" << runs.size() << " ROMs match in "
+            << std::setprecision(3) << seconds << "s" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
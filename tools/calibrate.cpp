@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CPU.h"
+#include "calibration.h"
+#include "display.h"
+#include "input.h"
+#include "memory.h"
+#include "quirks.h"
+#include "rom_profile.h"
+
+// finds the instructions per frame each ROM needs and stores them in the ROM
+// profiles, which the emulator uses when --ipf isn't given
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " <ROM file>... [options]\n"
+            << "options:\n"
+            << "  --profiles FILE   profiles to update (default: "
+            << RomProfiles::DEFAULT_FILE << ")\n"
+            << "  --frames N        frames played per setting (default:"
+            << " 7200)\n"
+            << "  --min-wait F      fraction of the time the ROM must spend"
+            << " waiting on\n"
+            << "                    the delay timer (default: 0.1)\n"
+            << "  --threads N       worker threads (default: all)\n"
+            << "  --quirks P        quirk profile: vip, chip48, schip or"
+            << " xochip\n"
+            << "                    (default: detected from each ROM)\n"
+            << "  --seed N          seed for the CXNN random numbers"
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+  CalibrationOptions options;
+  std::vector<const char*> rom_files;
+  const char* profiles_file = RomProfiles::DEFAULT_FILE;
+  bool detect_quirks = true;
+  uint64_t seed = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--profiles" && has_value) {
+      profiles_file = argv[++i];
+    } else if (arg == "--frames" && has_value) {
+      options.frames = std::atoi(argv[++i]);
+    } else if (arg == "--min-wait" && has_value) {
+      options.min_wait = std::atof(argv[++i]);
+    } else if (arg == "--threads" && has_value) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--quirks" && has_value) {
+      if (!parse_quirk_profile(argv[++i], options.quirks)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      detect_quirks = false;
+    } else if (arg == "--seed" && has_value) {
+      seed = std::strtoull(argv[++i], nullptr, 0);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      rom_files.push_back(argv[i]);
+    }
+  }
+  if (rom_files.empty() || options.frames <= 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  RomProfiles profiles;
+  if (!profiles.load(profiles_file)) {
+    return 1;
+  }
+
+  size_t skipped = 0;
+  for (const char* rom_file : rom_files) {
+    Memory memory;
+    Display display(true);
+    Input input;
+    CPU cpu(memory, display, input);
+    cpu.seed(seed);
+
+    memory.load_font();
+    if (!memory.load_rom(rom_file)) {
+      ++skipped;
+      continue;
+    }
+    if (detect_quirks) {
+      options.quirks = detect_quirk_profile(memory);
+    }
+
+    Snapshot root;
+    cpu.save_snapshot(root);
+    CalibrationResult result = calibrate(root, options);
+    profiles.set(memory.get_rom_hash(), {result.instructions_per_frame});
+
+    std::cout << rom_file << ": " << result.instructions_per_frame
+              << " instructions per frame"
+              << (result.paced ? "" : " (no delay timer waits)") << "\n";
+    for (const SpeedMeasurement& measurement : result.measurements) {
+      std::cout << "  " << std::setw(4) << measurement.instructions_per_frame
+                << "  " << std::fixed << std::setprecision(3)
+                << measurement.wait_fraction << std::defaultfloat << "\n";
+    }
+  }
+
+  if (!profiles.save(profiles_file)) {
+    return 1;
+  }
+  // the others are saved, but a script must not take this for a full run
+  if (skipped > 0) {
+    std::cerr << skipped << " ROM(s) could not be loaded and were skipped"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "analysis.h"
+#include "memory.h"
+
+// separates code from data in a ROM by following its control flow, prints an
+// annotated listing and optionally writes the control flow graph for Graphviz
+
+int main(int argc, char** argv) {
+  const char* dot_file = nullptr;
+  if (argc == 4 && std::strcmp(argv[2], "--dot") == 0) {
+    dot_file = argv[3];
+  } else if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <ROM file> [--dot FILE]"
+              << std::endl;
+    return 1;
+  }
+
+  Memory memory;
+  if (!memory.load_rom(argv[1])) {
+    return 1;
+  }
+  ProgramAnalysis analysis(memory.get_data(), 0x200, memory.get_rom_size());
+  analysis.write_listing(std::cout);
+
+  if (dot_file) {
+    std::ofstream file(dot_file);
+    if (!file.is_open()) {
+      std::cerr << "Failed to write graph file: " << dot_file << std::endl;
+      return 1;
+    }
+    analysis.write_graphviz(file);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "quirks.h"
+#include "rom_library.h"
+
+// indexes a directory of ROMs and lists it, the way a launcher would on
+// startup; the index is only rebuilt for the files that changed
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " <ROM directory> [options]\n"
+            << "options:\n"
+            << "  --index FILE   index file (default: "
+            << RomLibrary::DEFAULT_INDEX << " in the directory)\n"
+            << "  --list         print every ROM in the library\n"
+            << "  --find HASH    print the ROM with this content hash"
+            << std::endl;
+}
+
+static void print_rom(const RomInfo& info) {
+  std::cout << std::hex << std::setw(16) << std::setfill('0') << info.rom_hash
+            << std::dec << std::setfill(' ') << "  " << std::setw(6)
+            << quirk_profile_name(info.platform) << std::setw(6) << info.size
+            << "  " << info.path << "\n    " << info.title;
+  if (!info.credits.empty()) {
+    std::cout << " [" << info.credits << "]";
+  }
+  if (!info.summary.empty()) {
+    std::cout << ": " << info.summary;
+  }
+  std::cout << "\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::string directory = argv[1];
+  std::string index_file = directory + "/" + RomLibrary::DEFAULT_INDEX;
+  bool list = false;
+  bool find = false;
+  uint64_t rom_hash = 0;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--index" && has_value) {
+      index_file = argv[++i];
+    } else if (arg == "--list") {
+      list = true;
+    } else if (arg == "--find" && has_value) {
+      rom_hash = std::strtoull(argv[++i], nullptr, 16);
+      find = true;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  RomLibrary library;
+  LibraryScanStats stats;
+  if (!library.update(directory, index_file, &stats)) {
+    return 1;
+  }
+  std::cerr << stats.roms << " ROMs: " << stats.reused << " unchanged, "
+            << stats.read << " read, " << stats.skipped << " skipped"
+            << (stats.written ? ", index written" : "") << " in "
+            << stats.seconds * 1000.0 << " ms" << std::endl;
+
+  if (list) {
+    for (size_t i = 0; i < library.size(); ++i) {
+      print_rom(library.get(i));
+    }
+  }
+  if (find) {
+    RomInfo info;
+    if (!library.find(rom_hash, info)) {
+      std::cerr << "No ROM with that hash" << std::endl;
+      return 2;
+    }
+    print_rom(info);
+  }
+  return 0;
+}
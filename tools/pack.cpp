@@ -0,0 +1,100 @@
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "quirks.h"
+#include "rom_bundle.h"
+#include "rom_library.h"
+
+// packs directories of ROMs and their .txt sidecars into a bundle, or lists
+// the contents of one
+// ROMs are named by their path from the packed directory's parent, for
+// example "games/Pong (1 player).ch8" for roms/games
+
+namespace fs = std::filesystem;
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " <bundle file> <ROM directory>...\n"
+            << "       " << program << " --list <bundle file>" << std::endl;
+}
+
+static int list_bundle(const char* filename) {
+  RomBundle bundle;
+  if (!bundle.open(filename)) {
+    return 1;
+  }
+  for (size_t i = 0; i < bundle.size(); ++i) {
+    RomInfo info = bundle.get(i);
+    std::cout << std::hex << std::setw(16) << std::setfill('0')
+              << info.rom_hash << std::dec << std::setfill(' ') << "  "
+              << std::setw(6) << quirk_profile_name(info.platform)
+              << std::setw(6) << info.size << "  " << info.path << "\n";
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 3 && std::string(argv[1]) == "--list") {
+    return list_bundle(argv[2]);
+  }
+  if (argc < 3) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<RomBundle::Rom> roms;
+  size_t skipped = 0;
+  for (int i = 2; i < argc; ++i) {
+    fs::path directory = fs::path(argv[i]).lexically_normal();
+    if (!directory.has_filename()) {
+      directory = directory.parent_path();
+    }
+    std::error_code error;
+    fs::recursive_directory_iterator it(directory, error);
+    if (error) {
+      std::cerr << "Failed to scan ROM directory: " << argv[i] << std::endl;
+      return 1;
+    }
+
+    for (; it != fs::recursive_directory_iterator(); it.increment(error)) {
+      if (error) {
+        break;
+      }
+      std::string path = it->path().string();
+      if (!it->is_regular_file(error) || !is_rom_file(path)) {
+        continue;
+      }
+
+      MappedFile file;
+      RomBundle::Rom rom;
+      RomError rom_error;
+      if (!file.open(path)) {
+        std::cerr << "Skipping unreadable ROM: " << path << std::endl;
+        ++skipped;
+        continue;
+      }
+      if (!describe_rom(path, file.data(), file.size(), rom.metadata,
+                        &rom_error)) {
+        std::cerr << "Skipping " << rom_error.message() << std::endl;
+        ++skipped;
+        continue;
+      }
+      rom.name = (directory.filename() /
+                  fs::relative(it->path(), directory, error))
+                     .generic_string();
+      rom.data.assign(file.data(), file.data() + file.size());
+      roms.push_back(std::move(rom));
+    }
+  }
+
+  size_t packed = roms.size();
+  if (!RomBundle::write(argv[1], std::move(roms))) {
+    return 1;
+  }
+  std::cerr << packed << " ROMs packed, " << skipped << " skipped"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "CPU.h"
+#include "display.h"
+#include "input.h"
+#include "memory.h"
+#include "quirks.h"
+#include "search.h"
+
+// searches for a keypad input sequence that takes a ROM to a goal state
+// the inputs found are printed one key mask per line, each held for --hold
+// frames of --ipf instructions
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " <ROM file> [options] <goal>\n"
+            << "goals:\n"
+            << "  --goal-mem ADDR=VALUE   memory byte at ADDR equals VALUE\n"
+            << "  --goal-reg X=VALUE      register VX equals VALUE\n"
+            << "  --goal-pixel X,Y        pixel at X,Y is lit\n"
+            << "options:\n"
+            << "  --best                  best-first instead of breadth-first\n"
+            << "  --threads N             worker threads (default: all)\n"
+            << "  --ipf N                 instructions per frame (default: 10)\n"
+            << "  --quirks P              quirk profile: vip, chip48, schip or"
+            << " xochip\n"
+            << "                          (default: detected from the ROM)\n"
+            << "  --hold N                frames per input (default: 4)\n"
+            << "  --max-depth N           inputs per path (default: 64)\n"
+            << "  --max-states N          visited state cap (default: 1000000)\n"
+            << "  --max-memory MB         frontier and tree memory cap"
+            << " (default: 1024)\n"
+            << "  --seed N                seed for the CXNN random numbers"
+            << std::endl;
+}
+
+// parses "A=B" or "A,B" (numbers in any base accepted by strtol)
+static bool parse_pair(const char* arg, char separator, long& first,
+                       long& second) {
+  const char* split = std::strchr(arg, separator);
+  if (!split) {
+    return false;
+  }
+  first = std::strtol(arg, nullptr, 0);
+  second = std::strtol(split + 1, nullptr, 0);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  SearchOptions options;
+  bool has_goal = false;
+  uint64_t seed = 0;
+  bool detect_quirks = true;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    long a = 0;
+    long b = 0;
+
+    if (arg == "--best") {
+      options.strategy = SearchOptions::Strategy::best_first;
+    } else if (arg == "--threads" && has_value) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--ipf" && has_value) {
+      options.instructions_per_frame = std::atoi(argv[++i]);
+    } else if (arg == "--hold" && has_value) {
+      options.frames_per_input = std::atoi(argv[++i]);
+    } else if (arg == "--max-depth" && has_value) {
+      options.max_depth = std::atoi(argv[++i]);
+    } else if (arg == "--max-states" && has_value) {
+      options.max_states = std::strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "--max-memory" && has_value) {
+      options.max_memory = size_t(std::strtoull(argv[++i], nullptr, 0)) << 20;
+    } else if (arg == "--quirks" && has_value) {
+      if (!parse_quirk_profile(argv[++i], options.quirks)) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      detect_quirks = false;
+    } else if (arg == "--seed" && has_value) {
+      seed = std::strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "--goal-mem" && has_value &&
+               parse_pair(argv[++i], '=', a, b)) {
+      uint16_t address = uint16_t(a);
+      uint8_t value = uint8_t(b);
+      options.goal = [=](CPU& cpu) {
+        return cpu.get_memory().read(address) == value;
+      };
+      options.score = [=](CPU& cpu) {
+        return -int64_t(std::abs(cpu.get_memory().read(address) - value));
+      };
+      has_goal = true;
+    } else if (arg == "--goal-reg" && has_value &&
+               parse_pair(argv[++i], '=', a, b)) {
+      uint8_t reg = uint8_t(a & 0xF);
+      uint8_t value = uint8_t(b);
+      options.goal = [=](CPU& cpu) {
+        return cpu.get_registers()[reg] == value;
+      };
+      options.score = [=](CPU& cpu) {
+        return -int64_t(std::abs(cpu.get_registers()[reg] - value));
+      };
+      has_goal = true;
+    } else if (arg == "--goal-pixel" && has_value &&
+               parse_pair(argv[++i], ',', a, b)) {
+      // in pixels of the resolution the program is running in
+      int x = int(a);
+      int y = int(b);
+      options.goal = [=](CPU& cpu) {
+        const Display& display = cpu.get_display();
+        return display.get_pixel(x % display.get_width(),
+                                 y % display.get_height());
+      };
+      has_goal = true;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!has_goal) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  Memory memory;
+  Display display(true);
+  Input input;
+  CPU cpu(memory, display, input);
+  cpu.seed(seed);
+
+  memory.load_font();
+  if (!memory.load_rom(argv[1])) {
+    return 1;
+  }
+  if (detect_quirks) {
+    options.quirks = detect_quirk_profile(memory);
+  }
+
+  Snapshot root;
+  cpu.save_snapshot(root);
+
+  SearchResult result = search(root, options);
+
+  std::cerr << (result.found ? "goal reached" : "goal not reached") << ": "
+            << result.states_visited << " states visited, "
+            << result.states_expanded << " expanded in " << result.seconds
+            << "s, " << (result.peak_memory >> 20) << " MB peak"
+            << (result.out_of_memory ? " (memory cap reached)" : "")
+            << std::endl;
+
+  for (uint16_t keys : result.inputs) {
+    std::cout << "0x" << std::hex << std::setw(4) << std::setfill('0') << keys
+              << '\n';
+  }
+  return result.found ? 0 : 2;
+}
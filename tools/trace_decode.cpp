@@ -0,0 +1,43 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "disassembler.h"
+#include "trace.h"
+
+// turns an execution trace dump into readable disassembly with the register
+// changes of every instruction, oldest first
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace file>" << std::endl;
+    return 1;
+  }
+
+  std::vector<TraceRecord> records;
+  if (!ExecutionTrace::load(argv[1], records)) {
+    return 1;
+  }
+
+  for (const TraceRecord& record : records) {
+    std::printf("%03X  %04X  %-18s", record.pc, record.opcode,
+                disassemble(record.opcode).c_str());
+
+    int stored = 0;
+    for (int reg = 0; reg < 16; ++reg) {
+      if ((record.changed >> reg) & 1u) {
+        if (stored < 6) {
+          std::printf(" V%X=%02X", reg, record.values[stored++]);
+        }
+      }
+    }
+    if (record.flags & TraceRecord::TRUNCATED) {
+      std::printf(" ...");
+    }
+    if (record.flags & TraceRecord::I_CHANGED) {
+      std::printf(" I=%03X", record.I);
+    }
+    std::printf("\n");
+  }
+  return 0;
+}